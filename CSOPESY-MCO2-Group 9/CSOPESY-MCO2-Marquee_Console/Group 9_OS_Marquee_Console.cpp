@@ -19,29 +19,113 @@
 #include <algorithm>
 #include <queue>
 #include <condition_variable>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <ctime>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#ifdef MARQUEE_ALLOC_PROBE
+#include <new>
+#include <cstdlib>
+
+// --- Allocation probe: counts every heap allocation (see run_alloc_probe) ---
+// The replacements are kept out of line: inlined, GCC pairs a malloc'd `new`
+// with the `free` in `delete` and warns (-Wmismatched-new-delete).
+std::atomic<unsigned long long> heap_allocations{ 0 };
+
+#ifdef _MSC_VER
+#define PROBE_NOINLINE __declspec(noinline)
+#else
+#define PROBE_NOINLINE __attribute__((noinline))
+#endif
+
+PROBE_NOINLINE void* operator new(std::size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+PROBE_NOINLINE void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+PROBE_NOINLINE void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+PROBE_NOINLINE void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+PROBE_NOINLINE void operator delete[](void* p) noexcept {
+    ::operator delete(p);
+}
+
+PROBE_NOINLINE void operator delete[](void* p, std::size_t) noexcept {
+    ::operator delete(p);
+}
 #endif
 
-// --- Color Codes ---
+// --- Cell attributes ---
 // Part of: Console UI Implementation
-namespace Colors {
-    const std::string RESET = "\033[0m";
-    const std::string RED = "\033[31m";
-    const std::string GREEN = "\033[32m";
-    const std::string YELLOW = "\033[33m";
-    const std::string BLUE = "\033[34m";
-    const std::string MAGENTA = "\033[35m";
-    const std::string CYAN = "\033[36m";
-    const std::string WHITE = "\033[37m";
-    const std::string BRIGHT_RED = "\033[91m";
-    const std::string BRIGHT_GREEN = "\033[92m";
-    const std::string BRIGHT_YELLOW = "\033[93m";
-    const std::string BRIGHT_BLUE = "\033[94m";
-    const std::string BRIGHT_CYAN = "\033[96m";
-    const std::string BRIGHT_WHITE = "\033[97m";
-    const std::string BOLD = "\033[1m";
+// Packed foreground color + bold flag of one screen cell.
+// fg: 0 = terminal default, 1-8 = SGR 30-37, 9-16 = SGR 90-97,
+//     17-272 = 256-color palette entry (fg - 17)
+typedef unsigned short Attr;
+namespace Attrs {
+    const Attr RESET = 0;
+    const Attr RED = 2;
+    const Attr GREEN = 3;
+    const Attr YELLOW = 4;
+    const Attr BLUE = 5;
+    const Attr MAGENTA = 6;
+    const Attr CYAN = 7;
+    const Attr WHITE = 8;
+    const Attr BRIGHT_RED = 10;
+    const Attr BRIGHT_GREEN = 11;
+    const Attr BRIGHT_YELLOW = 12;
+    const Attr BRIGHT_BLUE = 13;
+    const Attr BRIGHT_MAGENTA = 14;
+    const Attr BRIGHT_CYAN = 15;
+    const Attr BRIGHT_WHITE = 16;
+    const Attr PALETTE = 17;
+    const Attr BOLD = 0x200;
+    const Attr FG_MASK = 0x1FF;
+
+    // entry of the 6x6x6 color cube of the 256-color palette (r, g, b in 0-5)
+    constexpr Attr cube(int r, int g, int b) { return static_cast<Attr>(PALETTE + 16 + 36 * r + 6 * g + b); }
 }
 
 // --- Layout constants (1-based coords) ---
@@ -51,567 +135,5625 @@ struct ConsoleLayout {
     int screen_height = 30;       // terminal height
     int marquee_width = 41;       // inner width of marquee box
     int marquee_top_row = 2;      // box top border
-    int marquee_text_row = 3;     // inner text row (where scrolling appears)
+    int marquee_text_row = 3;     // inner text row of the first lane (where scrolling appears)
+    int marquee_rows = 1;         // lane rows shown inside the box (a banner lane takes several)
     int marquee_bottom_row = 4;   // box bottom border
     int status_row = 6;           // status shows here
     int help_row = 7;             // help messages show here
     int prompt_row = 22;          // input prompt locked here (adjusted for developer info)
     int prompt_col = 1;           // column where prompt starts (">> ")
+    std::vector<Attr> gradient;   // gradient style color per marquee column
 };
 
-// --- Shared state ---
-std::atomic<bool> is_running{ true };
-std::atomic<bool> marquee_running{ false };
-std::string marquee_text = " Welcome to CSOPESY Marquee! ";
-std::atomic<int> marquee_speed{ 200 };  // ms
-std::atomic<int> marquee_position{ 0 };
-std::mutex marquee_state_mutex;
-ConsoleLayout layout;
-std::mutex layout_mutex;
-std::mutex console_mutex;
-std::mutex prompt_mutex;
-std::string prompt_display = ">> ";
-std::atomic<bool> help_visible{ false };
+// --- Command help entries (one help-area row each) ---
+// Part of: Command Recognition
+struct HelpEntry {
+    const char* name;
+    const char* description;
+    bool terminates;              // drawn in red
+};
 
-// --- Keyboard Handler ---
-std::queue<std::string> command_queue;
-std::mutex command_queue_mutex;
-std::condition_variable command_queue_cv;
+const HelpEntry help_entries[] = {
+    { "  help", " - displays the commands and its description", false },
+    { "  start_marquee [id]", " - starts the marquee animation (lane 1 if no id)", false },
+    { "  stop_marquee [id]", " - stops the marquee animation", false },
+    { "  set_text [#id] [text]", " - displays the text (asks when not given); a leading number is a lane only if it exists", false },
+    { "  set_source [id] [-f] <path>", " - scrolls a file or FIFO in constant memory (-f follows a growing log)", false },
+    { "  set_speed [id] [ms]", " - sets the marquee animation refresh in milliseconds (asks when not given)", false },
+    { "  set_style [id] <style>", " - plain, rainbow, gradient or keywords <word>... (highlights the words)", false },
+    { "  set_font [id] <font>", " - normal, or banner (large 7-row letters; the box grows to fit)", false },
+    { "  set_fps [fps]", " - caps how many frames per second are rendered (scroll speed is unaffected)", false },
+    { "  timing", " - shows achieved vs configured step rate and late/dropped frames per lane", false },
+    { "  jitter [reset]", " - shows a histogram of how late frames started (reset starts counting afresh)", false },
+    { "  stats [file]", " - shows live performance counters (stats <file> also writes them as JSON)", false },
+    { "  record <file>|stop", " - records the screen as a compact frame log (play it with --play <file>)", false },
+    { "  exit", " - terminates the console", true },
+};
+const int help_entry_count = static_cast<int>(sizeof(help_entries) / sizeof(help_entries[0]));
 
-// --- Terminal helpers ---
-void enable_ansi_on_windows() {
-#ifdef _WIN32
-    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (hOut == INVALID_HANDLE_VALUE) return;
-    DWORD mode = 0;
-    if (!GetConsoleMode(hOut, &mode)) return;
-    mode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
-    SetConsoleMode(hOut, mode);
-#endif
-}
+// --- One screen column of text ---
+// Part of: Console UI Implementation
+// The UTF-8 bytes of a grapheme (base character plus combining marks) and how
+// many columns it covers. A wide glyph is followed by a width-0 filler that
+// stands for its right half. Unused bytes stay zero so glyphs compare as a
+// whole; marks that do not fit in `bytes` are dropped.
+struct Glyph {
+    char bytes[14] = { ' ' };
+    unsigned char len = 1;     // bytes used (0 for the right half of a wide glyph)
+    unsigned char width = 1;   // columns covered: 0 (right half), 1 or 2
 
-// --- Get current console size ---
-void get_console_size(int& width, int& height) {
-#ifdef _WIN32
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (GetConsoleScreenBufferInfo(hOut, &csbi)) {
-        width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
-        height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+    bool operator==(const Glyph& other) const { return memcmp(this, &other, sizeof(Glyph)) == 0; }
+    bool operator!=(const Glyph& other) const { return !(*this == other); }
+
+    static Glyph ascii(char c) {
+        Glyph g;
+        g.bytes[0] = c;
+        return g;
     }
-    else {
-        width = 120;
-        height = 30;
+    static Glyph right_half() {
+        Glyph g;
+        g.bytes[0] = 0;
+        g.len = 0;
+        g.width = 0;
+        return g;
     }
-#else
-    width = 120;
-    height = 30;
-#endif
-}
+};
 
-// --- Update layout based on current console size ---
+// --- UTF-8 decoding and display width ---
 // Part of: Console UI Implementation
-void update_layout() {
-    std::lock_guard<std::mutex> lock(layout_mutex);
-    get_console_size(layout.screen_width, layout.screen_height);
+struct CodeRange {
+    unsigned int first;
+    unsigned int last;
+};
 
-    // adjust ONLY marquee width based on screen width (but keep reasonable limits)
-    layout.marquee_width = (std::min)((std::max)(41, layout.screen_width - 20), layout.screen_width - 4);
+// combining marks, joiners, variation selectors and emoji modifiers (take no column)
+const CodeRange zero_width_ranges[] = {
+    { 0x0300, 0x036F }, { 0x0483, 0x0489 }, { 0x0591, 0x05BD }, { 0x05BF, 0x05BF }, { 0x05C1, 0x05C2 },
+    { 0x05C4, 0x05C5 }, { 0x05C7, 0x05C7 }, { 0x0610, 0x061A }, { 0x064B, 0x065F }, { 0x0670, 0x0670 },
+    { 0x06D6, 0x06DC }, { 0x06DF, 0x06E4 }, { 0x06E7, 0x06E8 }, { 0x06EA, 0x06ED }, { 0x0711, 0x0711 },
+    { 0x0730, 0x074A }, { 0x07A6, 0x07B0 }, { 0x07EB, 0x07F3 }, { 0x0816, 0x082D }, { 0x0859, 0x085B },
+    { 0x08D3, 0x08E1 }, { 0x08E3, 0x0902 }, { 0x093A, 0x093A }, { 0x093C, 0x093C }, { 0x0941, 0x0948 },
+    { 0x094D, 0x094D }, { 0x0951, 0x0957 }, { 0x0962, 0x0963 }, { 0x0981, 0x0981 }, { 0x09BC, 0x09BC },
+    { 0x09C1, 0x09C4 }, { 0x09CD, 0x09CD }, { 0x09E2, 0x09E3 }, { 0x0A01, 0x0A02 }, { 0x0A3C, 0x0A3C },
+    { 0x0A41, 0x0A51 }, { 0x0A70, 0x0A71 }, { 0x0A75, 0x0A75 }, { 0x0A81, 0x0A82 }, { 0x0ABC, 0x0ABC },
+    { 0x0AC1, 0x0AC8 }, { 0x0ACD, 0x0ACD }, { 0x0AE2, 0x0AE3 }, { 0x0B01, 0x0B01 }, { 0x0B3C, 0x0B3C },
+    { 0x0B3F, 0x0B3F }, { 0x0B41, 0x0B44 }, { 0x0B4D, 0x0B4D }, { 0x0B56, 0x0B56 }, { 0x0B62, 0x0B63 },
+    { 0x0B82, 0x0B82 }, { 0x0BC0, 0x0BC0 }, { 0x0BCD, 0x0BCD }, { 0x0C00, 0x0C00 }, { 0x0C3E, 0x0C40 },
+    { 0x0C46, 0x0C56 }, { 0x0C62, 0x0C63 }, { 0x0CBC, 0x0CBC }, { 0x0CCC, 0x0CCD }, { 0x0D41, 0x0D44 },
+    { 0x0D4D, 0x0D4D }, { 0x0DCA, 0x0DCA }, { 0x0DD2, 0x0DD6 }, { 0x0E31, 0x0E31 }, { 0x0E34, 0x0E3A },
+    { 0x0E47, 0x0E4E }, { 0x0EB1, 0x0EB1 }, { 0x0EB4, 0x0EBC }, { 0x0EC8, 0x0ECD }, { 0x0F18, 0x0F19 },
+    { 0x0F35, 0x0F35 }, { 0x0F37, 0x0F37 }, { 0x0F39, 0x0F39 }, { 0x0F71, 0x0F7E }, { 0x0F80, 0x0F84 },
+    { 0x0F86, 0x0F87 }, { 0x0F8D, 0x0FBC }, { 0x102D, 0x1030 }, { 0x1032, 0x1037 }, { 0x1039, 0x103A },
+    { 0x1160, 0x11FF }, { 0x135D, 0x135F }, { 0x1712, 0x1714 }, { 0x17B4, 0x17B5 }, { 0x17B7, 0x17BD },
+    { 0x17C6, 0x17C6 }, { 0x17C9, 0x17D3 }, { 0x180B, 0x180E }, { 0x1A17, 0x1A18 }, { 0x1AB0, 0x1AFF },
+    { 0x1DC0, 0x1DFF }, { 0x200B, 0x200F }, { 0x202A, 0x202E }, { 0x2060, 0x2064 }, { 0x20D0, 0x20FF },
+    { 0x302A, 0x302D }, { 0x3099, 0x309A }, { 0xFE00, 0xFE0F }, { 0xFE20, 0xFE2F }, { 0xFEFF, 0xFEFF },
+    { 0x1F3FB, 0x1F3FF }, { 0xE0000, 0xE0FFF },
+};
 
-    // keep ALL elements FIXED - wag palitan based on screen size
-    layout.marquee_top_row = 2;                        // FIXED
-    layout.marquee_text_row = 3;                       // FIXED  
-    layout.marquee_bottom_row = 4;                     // FIXED
-    layout.status_row = 6;                             // FIXED
-    layout.help_row = 7;                               // FIXED
-    layout.prompt_row = layout.help_row + 15;          // FIXED 
-    layout.prompt_col = 1;                             // FIXED
-}
+// East Asian wide / fullwidth characters and emoji (take two columns)
+const CodeRange wide_ranges[] = {
+    { 0x1100, 0x115F }, { 0x231A, 0x231B }, { 0x2329, 0x232A }, { 0x23E9, 0x23EC }, { 0x23F0, 0x23F0 },
+    { 0x23F3, 0x23F3 }, { 0x25FD, 0x25FE }, { 0x2614, 0x2615 }, { 0x2648, 0x2653 }, { 0x267F, 0x267F },
+    { 0x2693, 0x2693 }, { 0x26A1, 0x26A1 }, { 0x26AA, 0x26AB }, { 0x26BD, 0x26BE }, { 0x26C4, 0x26C5 },
+    { 0x26CE, 0x26CE }, { 0x26D4, 0x26D4 }, { 0x26EA, 0x26EA }, { 0x26F2, 0x26F3 }, { 0x26F5, 0x26F5 },
+    { 0x26FA, 0x26FA }, { 0x26FD, 0x26FD }, { 0x2705, 0x2705 }, { 0x270A, 0x270B }, { 0x2728, 0x2728 },
+    { 0x274C, 0x274C }, { 0x274E, 0x274E }, { 0x2753, 0x2755 }, { 0x2757, 0x2757 }, { 0x2795, 0x2797 },
+    { 0x27B0, 0x27B0 }, { 0x27BF, 0x27BF }, { 0x2B1B, 0x2B1C }, { 0x2B50, 0x2B50 }, { 0x2B55, 0x2B55 },
+    { 0x2E80, 0x303E }, { 0x3041, 0x33FF }, { 0x3400, 0x4DBF }, { 0x4E00, 0x9FFF }, { 0xA000, 0xA4CF },
+    { 0xA960, 0xA97F }, { 0xAC00, 0xD7A3 }, { 0xF900, 0xFAFF }, { 0xFE10, 0xFE19 }, { 0xFE30, 0xFE6F },
+    { 0xFF00, 0xFF60 }, { 0xFFE0, 0xFFE6 }, { 0x16FE0, 0x16FE4 }, { 0x17000, 0x18AFF }, { 0x1B000, 0x1B2FF },
+    { 0x1F004, 0x1F004 }, { 0x1F0CF, 0x1F0CF }, { 0x1F18E, 0x1F18E }, { 0x1F191, 0x1F19A }, { 0x1F200, 0x1F251 },
+    { 0x1F300, 0x1F64F }, { 0x1F680, 0x1F6FF }, { 0x1F7E0, 0x1F7EB }, { 0x1F90C, 0x1F9FF }, { 0x1FA70, 0x1FAFF },
+    { 0x20000, 0x2FFFD }, { 0x30000, 0x3FFFD },
+};
 
-// --- 1-based column/row ---
-// Part of: Console UI Implementation
-void gotoxy(int col, int row) {
-    std::lock_guard<std::mutex> lock(console_mutex);
-    if (row < 1) row = 1;
-    if (col < 1) col = 1;
-    printf("\033[%d;%dH", row, col);
-    fflush(stdout);
+template <size_t N>
+bool in_ranges(unsigned int cp, const CodeRange (&ranges)[N]) {
+    const CodeRange* end = ranges + N;
+    const CodeRange* it = std::lower_bound(ranges, end, cp,
+        [](const CodeRange& range, unsigned int value) { return range.last < value; });
+    return it != end && it->first <= cp;
 }
 
-// --- Save cursor position ---
-// Part of: Console UI Implementation
-void save_cursor() {
-    std::lock_guard<std::mutex> lock(console_mutex);
-    printf("\033[s");
-    fflush(stdout);
+// columns a code point takes on its own (control characters are shown as spaces)
+int codepoint_width(unsigned int cp) {
+    if (cp < 0x7F) return 1;
+    if (cp < 0xA0) return 1;
+    if (in_ranges(cp, zero_width_ranges)) return 0;
+    return in_ranges(cp, wide_ranges) ? 2 : 1;
 }
 
-// --- Restore cursor position ---
-// Part of: Console UI Implementation
-void restore_cursor() {
-    std::lock_guard<std::mutex> lock(console_mutex);
-    printf("\033[u");
-    fflush(stdout);
+// decodes the code point at text[i]; returns its length (invalid bytes decode to U+FFFD, length 1)
+size_t decode_utf8(const char* text, size_t len, size_t i, unsigned int& cp) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text) + i;
+    size_t left = len - i;
+    unsigned char b = p[0];
+    size_t n = b < 0x80 ? 1 : (b >> 5) == 0x6 ? 2 : (b >> 4) == 0xE ? 3 : (b >> 3) == 0x1E ? 4 : 0;
+    if (n == 0 || n > left) {
+        cp = 0xFFFD;
+        return 1;
+    }
+    if (n == 1) {
+        cp = b;
+        return 1;
+    }
+    cp = b & (0x7F >> n);
+    for (size_t k = 1; k < n; ++k) {
+        if ((p[k] & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            return 1;
+        }
+        cp = (cp << 6) | (p[k] & 0x3F);
+    }
+    static const unsigned int min_value[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (cp < min_value[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) cp = 0xFFFD;
+    return n;
 }
 
-// --- Clear screen ---
+// --- Split the next grapheme off UTF-8 text ---
 // Part of: Console UI Implementation
-void clear_screen() {
-    std::lock_guard<std::mutex> lock(console_mutex);
-    printf("\033[2J\033[H");
-    fflush(stdout);
-}
+// Reads one user-perceived character starting at text[i] into `out` and
+// returns the index after it: the base code point plus any zero-width marks,
+// anything joined by U+200D, and regional indicator pairs (flags). This is the
+// subset of the Unicode segmentation rules that marquee text needs.
+size_t next_glyph(const char* text, size_t len, size_t i, Glyph& out) {
+    out = Glyph();
+    unsigned char b = static_cast<unsigned char>(text[i]);
+    if (b < 0x80 && (i + 1 == len || static_cast<unsigned char>(text[i + 1]) < 0x80)) {
+        out.bytes[0] = b < 0x20 || b == 0x7F ? ' ' : static_cast<char>(b);
+        return i + 1;
+    }
 
-// --- Clear a specific line ---
-// Part of: Console UI Implementation
-void clear_line(int row, int width = 0) {
-    if (width == 0) {
-        std::lock_guard<std::mutex> lock(layout_mutex);
-        width = layout.screen_width;
+    unsigned int cp = 0;
+    size_t n = decode_utf8(text, len, i, cp);
+    int width = codepoint_width(cp);
+    out.len = 0;
+    if (cp < 0x20 || (cp >= 0x7F && cp < 0xA0) || width == 0) {
+        out.bytes[out.len++] = ' '; // control character, or a mark with nothing to attach to
+        if (width != 0) i += n;
+        width = 1;
+    }
+    else {
+        if (cp == 0xFFFD && n == 1) {
+            memcpy(out.bytes, "\xEF\xBF\xBD", 3);
+            out.len = 3;
+        }
+        else {
+            memcpy(out.bytes, text + i, n);
+            out.len = static_cast<unsigned char>(n);
+        }
+        i += n;
     }
-    gotoxy(1, row);
-    std::cout << std::string(width, ' ') << std::flush;
-}
 
-// --- Displays help line ---
-// Part of: Display Implementation
-void show_help_line() {
-    std::lock_guard<std::mutex> lock(layout_mutex);
-    save_cursor();
-
-    // clear enough lines for multi-line help (ensure we don't clear the prompt area)
-    int max_help_row = layout.prompt_row - 2;
-    int end_help_row = (std::min)(layout.help_row + 13, max_help_row);
-    for (int row = layout.help_row + 8; row <= end_help_row + 2; ++row) {
-        clear_line(row, layout.screen_width);
-    }
-
-    // add a blank line before help list
-    gotoxy(1, layout.help_row + 8);
-    std::cout << std::endl;
-
-    // print help starting at adjusted HELP_ROW
-    gotoxy(1, layout.help_row + 9);
-    std::cout << Colors::BOLD << Colors::BRIGHT_CYAN << "Available Commands:" << Colors::RESET;
-    gotoxy(1, layout.help_row + 10);
-    std::cout << Colors::BRIGHT_YELLOW << "  help" << Colors::WHITE << " - displays the commands and its description";
-    gotoxy(1, layout.help_row + 11);
-    std::cout << Colors::BRIGHT_YELLOW << "  start_marquee" << Colors::WHITE << " - starts the marquee animation";
-    gotoxy(1, layout.help_row + 12);
-    std::cout << Colors::BRIGHT_YELLOW << "  stop_marquee" << Colors::WHITE << " - stops the marquee animation";
-    gotoxy(1, layout.help_row + 13);
-    std::cout << Colors::BRIGHT_YELLOW << "  set_text" << Colors::WHITE << " - accepts a text input and displays it as a marquee";
-    gotoxy(1, layout.help_row + 14);
-    std::cout << Colors::BRIGHT_YELLOW << "  set_speed" << Colors::WHITE << " - sets the marquee animation refresh in milliseconds";
-    gotoxy(1, layout.help_row + 15);
-    std::cout << Colors::BRIGHT_RED << "  exit" << Colors::WHITE << " - terminates the console";
-    std::cout << Colors::RESET << std::flush;
-
-    restore_cursor();
+    bool regional = cp >= 0x1F1E6 && cp <= 0x1F1FF;
+    bool joined = false;
+    while (i < len) {
+        unsigned int next = 0;
+        size_t m = decode_utf8(text, len, i, next);
+        bool attach = joined || codepoint_width(next) == 0
+            || (regional && next >= 0x1F1E6 && next <= 0x1F1FF);
+        if (!attach || next < 0x20) break;
+        if (regional && next >= 0x1F1E6 && next <= 0x1F1FF) {
+            width = 2; // a flag
+            regional = false;
+        }
+        joined = next == 0x200D;
+        if (out.len + m <= sizeof(out.bytes)) {
+            memcpy(out.bytes + out.len, text + i, m);
+            out.len = static_cast<unsigned char>(out.len + m);
+        }
+        i += m;
+    }
+    out.width = static_cast<unsigned char>(width);
+    return i;
 }
 
-// --- Draw the static UI once (title, marquee box, initial status/help, prompt) ---
-// Part of: Display Implementation
-void display_static_ui() {
-    update_layout(); // updates the layout based on current console size
+// --- Precomputed scroll strip ---
+// Part of: Marquee Animation Logic
+// Text split into display columns (one Glyph each, wide characters taking two)
+// followed by one window of blank columns, plus a copy of the first window
+// appended so every scroll position is a single contiguous slice. UTF-8 is
+// decoded only here, when the text or the marquee width changes, never per frame.
+struct MarqueeStrip {
+    std::vector<Glyph> columns;
+    int cycle = 0;   // number of scroll positions (text columns + padding)
+    int width = 0;   // visible window width in columns
 
-    clear_screen();
+    void build(const std::string& text, int window) {
+        width = (std::max)(window, 0);
+        columns.clear();
+        for (size_t i = 0; i < text.size();) {
+            Glyph glyph;
+            i = next_glyph(text.data(), text.size(), i, glyph);
+            columns.push_back(glyph);
+            if (glyph.width == 2) columns.push_back(Glyph::right_half());
+        }
+        wrap();
+    }
 
-    // title (row 1)
-    gotoxy(1, 1);
-    std::cout << Colors::BOLD << Colors::BRIGHT_BLUE
-        << "========= Welcome to CSOPESY Marquee Console ========="
-        << Colors::RESET;
+    // pads the columns laid out so far with a window of blanks and appends the
+    // copy of the first window
+    void wrap() {
+        cycle = static_cast<int>(columns.size()) + width;
+        columns.resize(static_cast<size_t>(cycle), Glyph());
+        columns.reserve(static_cast<size_t>(cycle + width));
+        for (int i = 0; i < width; ++i) columns.push_back(columns[i]);
+    }
 
-    // add a blank line before group developer list
-    gotoxy(1, 2);
-    std::cout << std::endl;
+    // visible slice for a scroll position, always `width` columns long
+    const Glyph* window(int pos) const { return columns.data() + pos; }
+};
 
-    // developer info (rows 3-6)
-    gotoxy(1, 3);
-    std::cout << Colors::BRIGHT_CYAN << "Group Developer: Alvarez, Ivan Antonio T." << Colors::RESET;
-    gotoxy(1, 4);
-    std::cout << Colors::BRIGHT_CYAN << "                 Barlaan, Bahir Benjamin C." << Colors::RESET;
-    gotoxy(1, 5);
-    std::cout << Colors::BRIGHT_CYAN << "                 Co, Joshua Benedict B." << Colors::RESET;
-    gotoxy(1, 6);
-    std::cout << Colors::BRIGHT_CYAN << "                 Tan, Reyvin Matthew T." << Colors::RESET;
-
-    // version date (row 7)
-    gotoxy(1, 7);
-    std::cout << std::endl;
-    gotoxy(1, 8);
-    std::cout << Colors::BRIGHT_YELLOW << "Version date: October 1, 2025" << Colors::RESET;
+// --- Read-copy-update snapshot ---
+// Part of: Thread Synchronization
+// Holds an immutable T that readers use without ever blocking: a read is two
+// atomic counter updates and a pointer load. A writer swaps in a new T and then
+// waits until every reader that could still see the old one has finished
+// (each of the two reader slots drains once) before deleting it. Writers are
+// serialised among themselves; readers must not publish while holding a read.
+template <typename T>
+class SnapshotCell {
+public:
+    class Read {
+    public:
+        Read(const SnapshotCell* cell, int slot) : cell(cell), slot(slot), value(cell->current.load()) {}
+        Read(Read&& other) : cell(other.cell), slot(other.slot), value(other.value) { other.cell = nullptr; }
+        ~Read() { if (cell) cell->readers[slot].fetch_sub(1); }
 
-    // marquee box (shifted down by 2 rows)
-    gotoxy(1, layout.marquee_top_row + 8);
-    std::cout << Colors::MAGENTA << "+" << std::string(layout.marquee_width, '-') << "+" << Colors::RESET;
-    gotoxy(1, layout.marquee_text_row + 8);
-    std::cout << Colors::MAGENTA << "|" << Colors::RESET << std::string(layout.marquee_width, ' ') << Colors::MAGENTA << "|" << Colors::RESET;
-    gotoxy(1, layout.marquee_bottom_row + 8);
-    std::cout << Colors::MAGENTA << "+" << std::string(layout.marquee_width, '-') << "+" << Colors::RESET;
+        const T& operator*() const { return *value; }
+        const T* operator->() const { return value; }
 
-    // status (shifted down by 2 rows)
-    gotoxy(1, layout.status_row + 8);
-    std::cout << Colors::BRIGHT_WHITE << "Status: " << Colors::RESET;
-    if (marquee_running.load())
-        std::cout << Colors::BRIGHT_GREEN << "Running" << Colors::RESET;
-    else
-        std::cout << Colors::RED << "Stopped" << Colors::RESET;
-    std::cout << Colors::BRIGHT_WHITE << " | Speed: " << Colors::YELLOW
-        << marquee_speed.load() << "ms" << Colors::RESET;
+    private:
+        Read(const Read&) = delete;
+        Read& operator=(const Read&) = delete;
 
-    // add a blank line before help tip (shifted down by 2 rows)
-    gotoxy(1, layout.help_row + 8);
-    std::cout << std::endl;
-    gotoxy(1, layout.help_row + 9);
-    std::cout << Colors::BRIGHT_GREEN << "Type 'help' for available commands." << Colors::RESET;
+        const SnapshotCell* cell;
+        int slot;
+        const T* value;
+    };
 
-    if (help_visible.load()) {
-        show_help_line();
+    explicit SnapshotCell(T* initial) : current(initial) {
+        readers[0] = 0;
+        readers[1] = 0;
     }
+    ~SnapshotCell() { delete current.load(); }
 
-    // prompt (shifted down by 2 rows)
-    gotoxy(layout.prompt_col, layout.prompt_row + 2);
-    std::cout << Colors::CYAN << prompt_display << Colors::RESET << std::flush;
-}
+    Read read() const {
+        int slot = active_slot.load();
+        readers[slot].fetch_add(1);
+        return Read(this, slot);
+    }
 
-// --- Update status line ---
-// Part of: Display Implementation
-void update_status_line() {
-    std::lock_guard<std::mutex> lock(layout_mutex);
-    save_cursor();
-    clear_line(layout.status_row + 8, layout.screen_width);
-    gotoxy(1, layout.status_row + 8);
-    std::cout << Colors::BRIGHT_WHITE << "Status: " << Colors::RESET;
-    if (marquee_running.load())
-        std::cout << Colors::BRIGHT_GREEN << "Running" << Colors::RESET;
-    else
-        std::cout << Colors::RED << "Stopped" << Colors::RESET;
-    std::cout << Colors::BRIGHT_WHITE << " | Speed: " << Colors::YELLOW
-        << marquee_speed.load() << "ms" << Colors::RESET << std::flush;
-    restore_cursor();
-}
+    void publish(std::unique_ptr<T> next) {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+        const T* old = current.exchange(next.release());
+        // flip new readers onto the other slot, then wait for each slot to drain once
+        for (int i = 0; i < 2; ++i) {
+            int slot = active_slot.fetch_xor(1);
+            while (readers[slot].load() != 0) std::this_thread::yield();
+        }
+        delete old;
+    }
+
+private:
+    SnapshotCell(const SnapshotCell&) = delete;
+    SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+    std::atomic<const T*> current;
+    mutable std::atomic<int> readers[2];
+    std::atomic<int> active_slot{ 0 };
+    std::mutex writer_mutex;
+};
 
-// --- Marquee thread: updates ONLY the MARQUEE_TEXT_ROW ---
+// --- Streaming marquee source ---
 // Part of: Marquee Animation Logic
-void marquee_thread_func(int display_width) {
-    while (is_running) {
-        if (marquee_running.load()) {
-            std::string text_copy;
-            int current_width;
-            {
-                std::lock_guard<std::mutex> lock(marquee_state_mutex);
-                text_copy = marquee_text;
-            }
-            {
-                std::lock_guard<std::mutex> lock(layout_mutex);
-                current_width = layout.marquee_width;
-            }
+// Scrolls a file, FIFO or growing log without loading it. A feeder thread reads
+// the source in chunks and decodes them into a fixed ring of glyph columns just
+// ahead of the visible window. The renderer publishes the column it has
+// scrolled to, and the feeder only reuses slots more than GUARD_COLUMNS behind
+// it, so memory stays constant however large the source is. The first
+// MAX_WINDOW slots are mirrored past the end of the ring so any window is one
+// contiguous slice.
+class StreamFeed {
+public:
+    static const int RING_COLUMNS = 16384;
+    static const int MAX_WINDOW = 1024;       // widest window a stream lane draws
+    static const int GUARD_COLUMNS = 1024;    // kept behind the renderer for redraws
+    static const size_t CHUNK_BYTES = 64 * 1024;
+    static const size_t HOLD_BACK = 32;       // bytes kept for the next chunk (a grapheme may be split)
+    static const int IDLE_POLL_MS = 200;      // how often an exhausted source is checked again
 
-            if (!text_copy.empty() && current_width > 0) {
-                std::string buffer = text_copy + std::string(current_width, ' ');
-                int len = static_cast<int>(buffer.size());
-                int pos = marquee_position.load();
-                if (pos >= len) pos = 0;
+    // opens the source and starts its feeder thread; nullptr if it cannot be opened
+    static std::shared_ptr<StreamFeed> open(const std::string& path, bool follow, int pad_columns) {
+        std::shared_ptr<StreamFeed> feed(new StreamFeed(follow, pad_columns));
+        if (!feed->open_source(path)) return nullptr;
+        std::thread(&StreamFeed::run, feed).detach(); // the thread keeps the feed alive until it stops
+        return feed;
+    }
 
-                std::string visible;
-                if (pos + current_width <= len) {
-                    visible = buffer.substr(pos, current_width);
-                }
-                else {
-                    int first = len - pos;
-                    visible = buffer.substr(pos, first) + buffer.substr(0, current_width - first);
-                }
+    ~StreamFeed() { close_source(); }
 
-                save_cursor();
-                {
-                    std::lock_guard<std::mutex> layout_lock(layout_mutex);
-                    gotoxy(2, layout.marquee_text_row + 8);
-                }
+    // columns decoded so far (the ring holds the most recent of them)
+    unsigned long long produced() const { return head.load(std::memory_order_acquire); }
 
-                {
-                    std::lock_guard<std::mutex> lock(console_mutex);
-                    printf("%s%-*s%s", Colors::WHITE.c_str(), current_width, visible.c_str(), Colors::RESET.c_str());
-                    fflush(stdout);
-                }
+    // the renderer will not read columns before `column` any more
+    void consume(unsigned long long column) { consumed.store(column, std::memory_order_release); }
 
-                restore_cursor();
-                marquee_position.store((pos + 1) % len);
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(marquee_speed.load()));
-        }
-        else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        }
-    }
-}
+    // `width` (<= MAX_WINDOW) columns starting at an absolute column
+    const Glyph* window(unsigned long long column) const { return ring.data() + column % RING_COLUMNS; }
 
-// --- Set marquee text ---
-// Part of: Marquee Animation Logic
-void set_marquee_text(const std::string& text) {
-    std::lock_guard<std::mutex> lock(marquee_state_mutex);
-    marquee_text = text.empty() ? " " : text;
-    marquee_position.store(0);
-}
+    // blank columns between passes over a looping file (the marquee width)
+    void set_padding(int columns) { pad.store(columns, std::memory_order_relaxed); }
 
-// --- Set marquee speed ---
-// Part of: Marquee Animation Logic
-void set_marquee_speed(int spd) {
-    if (spd > 0) marquee_speed.store(spd);
-    update_status_line();
-}
+    void stop() { stopping.store(true); }
 
-// --- Check if console size changed and redraw if needed ---
-void check_and_handle_resize() {
-    int current_width, current_height;
-    get_console_size(current_width, current_height);
+private:
+    StreamFeed(bool follow, int pad_columns)
+        : ring(static_cast<size_t>(RING_COLUMNS + MAX_WINDOW)), follow(follow), pad(pad_columns) {}
 
-    bool size_changed = false;
-    {
-        std::lock_guard<std::mutex> lock(layout_mutex);
-        if (current_width != layout.screen_width || current_height != layout.screen_height) {
-            size_changed = true;
+    StreamFeed(const StreamFeed&) = delete;
+    StreamFeed& operator=(const StreamFeed&) = delete;
+
+    // appends one column once the ring has room (false when stopping)
+    bool emit(const Glyph& glyph) {
+        unsigned long long column = head.load(std::memory_order_relaxed);
+        while (column + GUARD_COLUMNS >= consumed.load(std::memory_order_acquire) + RING_COLUMNS) {
+            if (stopping.load()) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
         }
+        size_t slot = static_cast<size_t>(column % RING_COLUMNS);
+        ring[slot] = glyph;
+        if (slot < static_cast<size_t>(MAX_WINDOW)) ring[RING_COLUMNS + slot] = glyph;
+        head.store(column + 1, std::memory_order_release);
+        return true;
     }
 
-    if (size_changed) {
-        // small delay to let resize complete and prevent flicker
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        display_static_ui(); // This will update layout and redraw
+    // decodes bytes [0, end) of the chunk buffer; returns where decoding stopped
+    size_t decode(const char* bytes, size_t len, size_t end) {
+        size_t i = 0;
+        Glyph glyph;
+        while (i < end && !stopping.load(std::memory_order_relaxed)) {
+            i = next_glyph(bytes, len, i, glyph);
+            if (!emit(glyph)) break;
+            if (glyph.width == 2 && !emit(Glyph::right_half())) break;
+        }
+        return (std::min)(i, len);
     }
-}
 
-// --- Background resize monitoring thread ---
-void resize_monitor_thread_func() {
-    while (is_running) {
-        check_and_handle_resize();
-        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // check every 100ms
-    }
-}
+    void run() {
+        std::vector<char> buffer(CHUNK_BYTES + HOLD_BACK);
+        size_t carry = 0;               // undecoded bytes at the front of the buffer
+        bool pass_had_text = false;     // anything read since the last rewind
+        while (!stopping.load()) {
+            long n = read_some(buffer.data() + carry, CHUNK_BYTES);
+            if (n < 0) continue;        // nothing yet (timed out); check for stop and retry
+            if (n > 0) {
+                size_t len = carry + static_cast<size_t>(n);
+                size_t used = decode(buffer.data(), len, len > HOLD_BACK ? len - HOLD_BACK : 0);
+                carry = len - used;
+                memmove(buffer.data(), buffer.data() + used, carry);
+                pass_had_text = true;
+                continue;
+            }
 
-// --- Keyboard Handler ---
-// Part of: Command Recognition
-void keyboard_handler_thread_func() {
-    std::string line;
-    while (is_running) {
-        if (!std::getline(std::cin, line)) { // EOF or error
-            is_running = false;
-            command_queue_cv.notify_all();
-            break;
+            // end of the data for now
+            if (carry > 0) carry -= decode(buffer.data(), carry, carry);
+            if (!follow && pass_had_text && rewind_source()) {
+                // a looping file: a window of blanks, then the text again
+                int blanks = pad.load(std::memory_order_relaxed);
+                for (int i = 0; i < blanks; ++i) emit(Glyph());
+                pass_had_text = false;
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_POLL_MS));
+            if (follow) check_truncated();
         }
+    }
 
-        // sanitize input
-        auto trim = [](std::string& s) {
-            s.erase(0, s.find_first_not_of(" \t\r\n"));
-            if (!s.empty()) s.erase(s.find_last_not_of(" \t\r\n") + 1);
-            };
-        trim(line);
-
-        if (line.empty()) continue;
+#ifdef _WIN32
+    bool open_source(const std::string& path) {
+        file = fopen(path.c_str(), "rb");
+        return file != nullptr;
+    }
+    void close_source() {
+        if (file) fclose(file);
+    }
+    // bytes read, 0 at the end of the data, -1 if nothing arrived in time
+    long read_some(char* out, size_t len) {
+        size_t n = fread(out, 1, len, file);
+        if (n == 0) clearerr(file);
+        return static_cast<long>(n);
+    }
+    bool rewind_source() { return fseek(file, 0, SEEK_SET) == 0; }
+    void check_truncated() {}
 
-        {
-            std::lock_guard<std::mutex> lock(command_queue_mutex);
-            command_queue.push(line);
+    FILE* file = nullptr;
+#else
+    bool open_source(const std::string& path) {
+        // non-blocking so opening a FIFO does not wait for a writer
+        fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+            pipe = true;
+            follow = true; // a pipe cannot be rewound
         }
-        command_queue_cv.notify_one();
+        return true;
+    }
+    void close_source() {
+        if (fd >= 0) ::close(fd);
+    }
+    // bytes read, 0 at the end of the data, -1 if nothing arrived in time
+    long read_some(char* out, size_t len) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, IDLE_POLL_MS) <= 0) return -1;
+        ssize_t n = ::read(fd, out, len);
+        if (n < 0) return (errno == EAGAIN || errno == EINTR) ? -1 : 0;
+        return static_cast<long>(n);
+    }
+    bool rewind_source() { return !pipe && lseek(fd, 0, SEEK_SET) == 0; }
+    // a followed log that was truncated (rotated in place) starts over
+    void check_truncated() {
+        struct stat st;
+        if (pipe || fstat(fd, &st) != 0) return;
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (offset > st.st_size) lseek(fd, 0, SEEK_SET);
     }
-}
 
-// --- Helper: redraw prompt and position cursor ---
-void redraw_prompt_and_place_cursor() {
-    std::lock_guard<std::mutex> prompt_lock(prompt_mutex);
-    std::lock_guard<std::mutex> layout_lock(layout_mutex);
-    clear_line(layout.prompt_row + 2, layout.screen_width);
-    gotoxy(layout.prompt_col, layout.prompt_row + 2);
-    std::cout << Colors::CYAN << prompt_display << Colors::RESET << std::flush;
-    int input_col = layout.prompt_col + static_cast<int>(prompt_display.size());
-    gotoxy(input_col, layout.prompt_row + 2);
-}
+    int fd = -1;
+    bool pipe = false;
+#endif
 
-// --- Main ---
-// Part of: Command Recognition & Command Interpreter
-int main() {
-    enable_ansi_on_windows();
+    std::vector<Glyph> ring;
+    std::atomic<unsigned long long> head{ 0 };       // next column to decode
+    std::atomic<unsigned long long> consumed{ 0 };   // renderer's scroll column
+    std::atomic<bool> stopping{ false };
+    bool follow;                                     // wait for appended data instead of looping
+    std::atomic<int> pad;
+};
 
-    // draw UI once
-    display_static_ui();
+// definitions for the constants that are bound by reference ((std::min), milliseconds)
+const int StreamFeed::RING_COLUMNS;
+const int StreamFeed::MAX_WINDOW;
+const int StreamFeed::GUARD_COLUMNS;
+const size_t StreamFeed::CHUNK_BYTES;
+const size_t StreamFeed::HOLD_BACK;
+const int StreamFeed::IDLE_POLL_MS;
 
-    // start marquee thread
-    std::thread marquee_thread(marquee_thread_func, layout.marquee_width);
+// --- Lane color styles ---
+// Part of: Marquee Animation Logic
+// Colors come from tables, never from per-frame computation: rainbow and
+// keyword colors follow the text and are laid out once per text (or read from
+// the compile-time rainbow run for streams), gradient colors belong to screen
+// columns and are laid out once per width. Neighbouring columns mostly share
+// a color, so the screen diff emits an SGR change only at band edges.
+enum MarqueeStyle {
+    STYLE_PLAIN,
+    STYLE_RAINBOW,
+    STYLE_GRADIENT,
+    STYLE_KEYWORDS
+};
 
-    // start resize monitoring thread
-    std::thread resize_thread(resize_monitor_thread_func);
+const Attr rainbow_colors[] = {
+    Attrs::BRIGHT_RED, Attrs::BRIGHT_YELLOW, Attrs::BRIGHT_GREEN,
+    Attrs::BRIGHT_CYAN, Attrs::BRIGHT_BLUE, Attrs::BRIGHT_MAGENTA
+};
+const int RAINBOW_BAND = 6;   // text columns per rainbow color
+const int RAINBOW_PERIOD = RAINBOW_BAND * static_cast<int>(sizeof(rainbow_colors) / sizeof(rainbow_colors[0]));
 
-    // --- Keyboard Handler ---
-    std::thread keyboard_thread(keyboard_handler_thread_func);
+const Attr gradient_colors[] = {
+    Attrs::cube(0, 1, 5), Attrs::cube(0, 2, 5), Attrs::cube(0, 3, 5), Attrs::cube(0, 4, 5),
+    Attrs::cube(0, 5, 5), Attrs::cube(0, 5, 4), Attrs::cube(0, 5, 3), Attrs::cube(0, 5, 2)
+};
+const int GRADIENT_STEPS = static_cast<int>(sizeof(gradient_colors) / sizeof(gradient_colors[0]));
 
-    enum CommandState { NORMAL, WAITING_TEXT, WAITING_SPEED };
-    CommandState state = NORMAL;
+const Attr KEYWORD_ATTR = Attrs::BOLD | Attrs::BRIGHT_YELLOW;
 
-    while (is_running) {
-        std::string line;
-        {
-            std::unique_lock<std::mutex> lock(command_queue_mutex);
-            command_queue_cv.wait(lock, [] {
-                return !command_queue.empty() || !is_running.load();
-                });
+// rainbow colors for absolute columns 0 .. RAINBOW_PERIOD + MAX_WINDOW, built
+// by the compiler; a window starting at column c uses the slice at c % period
+struct RainbowRun {
+    Attr attr[RAINBOW_PERIOD + StreamFeed::MAX_WINDOW];
 
-            if (!is_running) break;
+    constexpr RainbowRun() : attr() {
+        for (int i = 0; i < RAINBOW_PERIOD + StreamFeed::MAX_WINDOW; ++i) attr[i] = rainbow_colors[(i % RAINBOW_PERIOD) / RAINBOW_BAND];
+    }
+};
+constexpr RainbowRun rainbow_run{};
 
-            line = command_queue.front();
-            command_queue.pop();
-        }
+const char* const style_names[] = { "plain", "rainbow", "gradient", "keywords" };
 
-        
-        // cursor to the prompt position.
-        redraw_prompt_and_place_cursor();
+// --- Banner font ---
+// Part of: Marquee Animation Logic
+// A 5x7 bitmap font for printable ASCII, stored column-major: one byte per
+// glyph column, bit 0 the top row. Text set in the banner font is rendered
+// through it once, when the text or the width changes; frames only copy
+// windows out of the resulting row strips.
+enum MarqueeFont {
+    FONT_NORMAL,
+    FONT_BANNER
+};
 
-        // handle WAITING states: these are inputs for multi-step commands
-        if (state == WAITING_TEXT) {
-            set_marquee_text(line);
-            state = NORMAL;
-            {
-                std::lock_guard<std::mutex> lock(prompt_mutex);
-                prompt_display = ">> ";
-            }
-            update_status_line();
+const char* const font_names[] = { "normal", "banner" };
 
-            // redraw prompt for next input
-            redraw_prompt_and_place_cursor();
-            continue;
-        }
-        if (state == WAITING_SPEED) {
-            try {
-                int v = std::stoi(line);
-                if (v > 0) set_marquee_speed(v);
-            }
-            catch (...) { /* ignore */ }
-            state = NORMAL;
-            {
-                std::lock_guard<std::mutex> lock(prompt_mutex);
-                prompt_display = ">> ";
-            }
-            update_status_line();
+const int BANNER_ROWS = 7;        // font rows (box rows a banner lane takes)
+const int BANNER_COLUMNS = 5;     // glyph columns
+const int BANNER_ADVANCE = 6;     // glyph columns plus one blank spacer
+const char* const BANNER_PIXEL = "\xE2\x96\x88";  // U+2588 FULL BLOCK
 
-            // redraw prompt for next input
-            redraw_prompt_and_place_cursor();
-            continue;
-        }
+const unsigned char banner_font[][BANNER_COLUMNS] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 }, // space ! "
+    { 0x14, 0x7F, 0x14, 0x7F, 0x14 }, { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 }, // # $ %
+    { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, { 0x00, 0x1C, 0x22, 0x41, 0x00 }, // & ' (
+    { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x08, 0x2A, 0x1C, 0x2A, 0x08 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 }, // ) * +
+    { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 }, // , - .
+    { 0x20, 0x10, 0x08, 0x04, 0x02 }, { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 }, // / 0 1
+    { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 }, { 0x18, 0x14, 0x12, 0x7F, 0x10 }, // 2 3 4
+    { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 }, // 5 6 7
+    { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E }, { 0x00, 0x36, 0x36, 0x00, 0x00 }, // 8 9 :
+    { 0x00, 0x56, 0x36, 0x00, 0x00 }, { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 }, // ; < =
+    { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 }, { 0x32, 0x49, 0x79, 0x41, 0x3E }, // > ? @
+    { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 }, // A B C
+    { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x01, 0x01 }, // D E F
+    { 0x3E, 0x41, 0x41, 0x51, 0x32 }, { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 }, // G H I
+    { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 }, { 0x7F, 0x40, 0x40, 0x40, 0x40 }, // J K L
+    { 0x7F, 0x02, 0x04, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E }, // M N O
+    { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 }, // P Q R
+    { 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F }, // S T U
+    { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x7F, 0x20, 0x18, 0x20, 0x7F }, { 0x63, 0x14, 0x08, 0x14, 0x63 }, // V W X
+    { 0x03, 0x04, 0x78, 0x04, 0x03 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x00 }, // Y Z [
+    { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 }, // \ ] ^
+    { 0x40, 0x40, 0x40, 0x40, 0x40 }, { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 }, // _ ` a
+    { 0x7F, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 }, { 0x38, 0x44, 0x44, 0x48, 0x7F }, // b c d
+    { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7E, 0x09, 0x01, 0x02 }, { 0x0C, 0x52, 0x52, 0x52, 0x3E }, // e f g
+    { 0x7F, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7D, 0x40, 0x00 }, { 0x20, 0x40, 0x44, 0x3D, 0x00 }, // h i j
+    { 0x7F, 0x10, 0x28, 0x44, 0x00 }, { 0x00, 0x41, 0x7F, 0x40, 0x00 }, { 0x7C, 0x04, 0x18, 0x04, 0x78 }, // k l m
+    { 0x7C, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 }, { 0x7C, 0x14, 0x14, 0x14, 0x08 }, // n o p
+    { 0x08, 0x14, 0x14, 0x18, 0x7C }, { 0x7C, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 }, // q r s
+    { 0x04, 0x3F, 0x44, 0x40, 0x20 }, { 0x3C, 0x40, 0x40, 0x20, 0x7C }, { 0x1C, 0x20, 0x40, 0x20, 0x1C }, // t u v
+    { 0x3C, 0x40, 0x30, 0x40, 0x3C }, { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0C, 0x50, 0x50, 0x50, 0x3C }, // w x y
+    { 0x44, 0x64, 0x54, 0x4C, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 }, { 0x00, 0x00, 0x7F, 0x00, 0x00 }, // z { |
+    { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x08, 0x04, 0x08, 0x10, 0x08 },                                   // } ~
+};
+static_assert(sizeof(banner_font) / sizeof(banner_font[0]) == 0x7F - 0x20, "banner font covers 0x20-0x7E");
 
-        // normal commands
-        if (line == "help") {
-            help_visible = true;
-            // ensure prompt is visible and saved for restore
-            redraw_prompt_and_place_cursor();
-            show_help_line();
-        }
-        else if (line == "start_marquee") {
-            marquee_running = true;
-            help_visible = false;
+// atlas columns for the glyph a banner shows (anything but printable ASCII as '?')
+const unsigned char* banner_glyph(const Glyph& glyph) {
+    unsigned char c = static_cast<unsigned char>(glyph.bytes[0]);
+    if (glyph.len != 1 || c < 0x20 || c > 0x7E) c = '?';
+    return banner_font[c - 0x20];
+}
 
-            {
-                std::lock_guard<std::mutex> layout_lock(layout_mutex);
-                // clear help area
-                for (int row = layout.help_row + 8; row <= layout.help_row + 15; ++row)
-                    clear_line(row, layout.screen_width);
-                // print help tip
-                gotoxy(1, layout.help_row + 8);
-                std::cout << std::endl;
-                gotoxy(1, layout.help_row + 9);
-                std::cout << Colors::BRIGHT_GREEN << "Type 'help' for available commands." << Colors::RESET << std::flush;
-            }
-            update_status_line();
-        }
-        else if (line == "stop_marquee") {
-            marquee_running = false;
-            help_visible = false;
+// one cell of a banner glyph on a font row: lit pixels are full blocks
+Glyph banner_cell(const unsigned char* columns, int column, int row) {
+    Glyph cell;
+    if ((columns[column] >> row) & 1) {
+        memcpy(cell.bytes, BANNER_PIXEL, 3);
+        cell.len = 3;
+    }
+    return cell;
+}
 
-            {
-                std::lock_guard<std::mutex> layout_lock(layout_mutex);
-                // clear help area
-                for (int row = layout.help_row + 8; row <= layout.help_row + 15; ++row)
-                    clear_line(row, layout.screen_width);
-                // print help tip
-                gotoxy(1, layout.help_row + 8);
-                std::cout << std::endl;
-                gotoxy(1, layout.help_row + 9);
-                std::cout << Colors::BRIGHT_GREEN << "Type 'help' for available commands." << Colors::RESET << std::flush;
-            }
-            update_status_line();
-        }
-        else if (line == "set_text") {
-            help_visible = false;
-
-            state = WAITING_TEXT;
-            {
-                std::lock_guard<std::mutex> lock(prompt_mutex);
-                prompt_display = "Enter text for marquee: ";
-            }
-            // immediately show updated prompt so user knows to type the text
-            redraw_prompt_and_place_cursor();
+// --- Dynamic text fields ---
+// Part of: Marquee Animation Logic
+// Placeholders in a lane's text: {time} (HH:MM:SS) and {file:/path} (the
+// first line of a file, e.g. a metric another program keeps updated). The text
+// is parsed once into literal parts and fields; each field is evaluated once
+// then, and the width of that first value is reserved in the strip for good,
+// so later values are padded or cut to it and the text never shifts. After
+// that the render thread re-evaluates a field only while it is in the visible
+// window of a running lane and its refresh interval has passed; fields off
+// screen cost nothing, and a stopped lane keeps the values it shows. File
+// fields are evaluated from FileFieldCache, so no file is opened under a lock.
+enum FieldKind {
+    FIELD_TIME,
+    FIELD_FILE
+};
 
-            {
-                std::lock_guard<std::mutex> layout_lock(layout_mutex);
-                // clear help area
-                for (int row = layout.help_row + 8; row <= layout.help_row + 15; ++row)
-                    clear_line(row, layout.screen_width);
-                // print help tip
-                gotoxy(1, layout.help_row + 8);
-                std::cout << std::endl;
-                gotoxy(1, layout.help_row + 9);
-                std::cout << Colors::BRIGHT_GREEN << "Type 'help' for available commands." << Colors::RESET << std::flush;
-            }
-            update_status_line();
-        }
-        else if (line == "set_speed") {
-            help_visible = false;
-
-            state = WAITING_SPEED;
-            {
-                std::lock_guard<std::mutex> lock(prompt_mutex);
-                prompt_display = "Enter speed in ms: ";
-            }
-            // immediately show updated prompt so user knows to type the speed
-            redraw_prompt_and_place_cursor();
+struct TextField {
+    FieldKind kind = FIELD_TIME;
+    std::string path;             // FIELD_FILE
+    int column = 0;               // first strip column
+    int width = 0;                // strip columns reserved (measured from the first value)
+    std::chrono::milliseconds refresh{ 1000 };
+};
 
-            {
-                std::lock_guard<std::mutex> layout_lock(layout_mutex);
-                // clear help area
-                for (int row = layout.help_row + 8; row <= layout.help_row + 15; ++row)
-                    clear_line(row, layout.screen_width);
-                // print help tip
-                gotoxy(1, layout.help_row + 8);
-                std::cout << std::endl;
-                gotoxy(1, layout.help_row + 9);
-                std::cout << Colors::BRIGHT_GREEN << "Type 'help' for available commands." << Colors::RESET << std::flush;
-            }
-            update_status_line();
-        }
-        else if (line == "exit") {
+const int FIELD_VALUE_BYTES = 256;    // most of a value that is read
+const int FIELD_MAX_WIDTH = 64;       // display columns a value may reserve
+const int FIELD_MISSING_WIDTH = 8;    // reserved when there is no first value (file not there yet)
+
+// first bytes of a file, no allocations; 0 when it cannot be read
+size_t read_file_head(const char* path, char* out, size_t cap) {
+#ifdef _WIN32
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    size_t n = fread(out, 1, cap, file);
+    fclose(file);
+    return n;
+#else
+    int fd = ::open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = ::read(fd, out, cap);
+    ::close(fd);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+#endif
+}
+
+// --- Cached values of {file:} fields ---
+// Part of: Marquee Animation Logic
+// A FIFO with no writer or a file on a slow mount can block whoever reads it,
+// and texts are built under layout_mutex and marquee_state_mutex and fields
+// refreshed under screen_mutex. So those paths only copy the first bytes of a
+// file from here. A command reads the files its text names before it takes
+// any lock (prefetch); after that a reader thread re-reads a file when a
+// lookup finds its value older than REFRESH, so a shown value is at most about
+// one refresh behind. The cache mutex is held only to copy bytes, never
+// across I/O, and lookups never allocate: a path prefetch did not add reads
+// as missing. Paths no published text names any more are pruned.
+class FileFieldCache {
+public:
+    typedef std::chrono::steady_clock Clock;
+    static const int REFRESH_MS = 1000;
+
+    // creates the cache and starts its reader thread
+    static std::shared_ptr<FileFieldCache> start() {
+        std::shared_ptr<FileFieldCache> cache(new FileFieldCache());
+        std::thread(&FileFieldCache::run, cache).detach(); // the thread keeps the cache alive
+        return cache;
+    }
+
+    // reads the files named by the {file:} placeholders of a text whose values
+    // are missing or stale; the caller must hold no lock
+    void prefetch(const std::string& text) {
+        for (size_t open = text.find("{file:"); open != std::string::npos; open = text.find("{file:", open + 1)) {
+            size_t close = text.find('}', open);
+            if (close == std::string::npos) break;
+            if (close == open + 6) continue;
+            std::string path = text.substr(open + 6, close - open - 6);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = entries.find(path);
+                if (it != entries.end() && !it->second.dropped && Clock::now() - it->second.read_at < refresh_interval()) continue;
+            }
+            char head[FIELD_VALUE_BYTES];
+            size_t len = read_file_head(path.c_str(), head, sizeof(head));
+            std::lock_guard<std::mutex> lock(mutex);
+            store(entries[path], head, len);
+        }
+    }
+
+    // the cached first bytes of a file in out[0, cap); 0 when the path was
+    // not prefetched or the file cannot be read. A stale value is still
+    // returned, and queued for the reader.
+    size_t head(const std::string& path, char* out, size_t cap) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(path);
+        if (it == entries.end() || it->second.dropped) return 0;
+        Entry& entry = it->second;
+        if (!entry.queued && Clock::now() - entry.read_at >= refresh_interval()) {
+            entry.queued = true;
+            queued = true;
+            wake.notify_one();
+        }
+        size_t len = (std::min)(cap, entry.len);
+        memcpy(out, entry.bytes, len);
+        return len;
+    }
+
+    // forgets every path `used(path)` is false for (a file being read is
+    // forgotten by the reader once it is done)
+    template <typename Used>
+    void prune(Used used) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (used(it->first)) {
+                ++it;
+            }
+            else if (it->second.reading) {
+                it->second.dropped = true;
+                ++it;
+            }
+            else {
+                it = entries.erase(it);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        char bytes[FIELD_VALUE_BYTES];
+        size_t len = 0;
+        Clock::time_point read_at;
+        bool queued = false;    // the reader is to read it again
+        bool reading = false;   // the reader has it open (not erased meanwhile)
+        bool dropped = false;   // pruned while it was being read
+    };
+
+    FileFieldCache() = default;
+
+    static Clock::duration refresh_interval() { return std::chrono::milliseconds(REFRESH_MS); }
+
+    // caller holds mutex
+    void store(Entry& entry, const char* bytes, size_t len) {
+        memcpy(entry.bytes, bytes, len);
+        entry.len = len;
+        entry.read_at = Clock::now();
+        entry.queued = false;
+        entry.dropped = false;
+    }
+
+    // reader thread: reads every queued file with the mutex released. The
+    // entry being read is marked so prune() leaves it (and its path) in place;
+    // std::map keeps it valid while other entries come and go.
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return queued; });
+            queued = false;
+            for (auto it = entries.begin(); it != entries.end();) {
+                if (!it->second.queued) {
+                    ++it;
+                    continue;
+                }
+                const char* path = it->first.c_str();
+                char head[FIELD_VALUE_BYTES];
+                it->second.reading = true;
+                lock.unlock();
+                size_t len = read_file_head(path, head, sizeof(head));
+                lock.lock();
+                it->second.reading = false;
+                if (it->second.dropped) {
+                    it = entries.erase(it);
+                    continue;
+                }
+                store(it->second, head, len);
+                ++it;
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool queued = false;                  // some entry is queued (guarded by mutex)
+    std::map<std::string, Entry> entries; // by path (guarded by mutex)
+};
+
+const int FileFieldCache::REFRESH_MS;
+
+// the process-wide cache, started on first use
+FileFieldCache& file_fields() {
+    static std::shared_ptr<FileFieldCache> cache = FileFieldCache::start();
+    return *cache;
+}
+
+// current value of a field as one line of UTF-8 in out[0, cap); returns its length
+size_t field_value(const TextField& field, char* out, size_t cap) {
+    if (field.kind == FIELD_TIME) {
+        std::time_t now = std::time(nullptr);
+        std::tm local;
+#ifdef _WIN32
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local);
+#endif
+        return strftime(out, cap, "%H:%M:%S", &local);
+    }
+    size_t n = file_fields().head(field.path, out, cap);
+    size_t len = 0;
+    for (; len < n && out[len] != '\n' && out[len] != '\r'; ++len)
+        if (static_cast<unsigned char>(out[len]) < 0x20) out[len] = ' ';
+    while (len > 0 && out[len - 1] == ' ') --len;
+    return len;
+}
+
+// lays a value out over a field's strip columns on every font row
+// (`rows` rows of `width` glyphs); what does not fit is cut, the rest is blank
+void layout_field(const char* value, size_t len, int width, int rows, Glyph* out) {
+    std::fill(out, out + static_cast<size_t>(width) * rows, Glyph());
+    int col = 0;
+    Glyph glyph;
+    for (size_t i = 0; i < len;) {
+        i = next_glyph(value, len, i, glyph);
+        if (rows > 1) {
+            if (col + BANNER_ADVANCE > width) break;
+            const unsigned char* columns = banner_glyph(glyph);
+            for (int row = 0; row < rows; ++row)
+                for (int c = 0; c < BANNER_COLUMNS; ++c) out[row * width + col + c] = banner_cell(columns, c, row);
+            col += BANNER_ADVANCE;
+            continue;
+        }
+        if (col + glyph.width > width) break;
+        out[col] = glyph;
+        if (glyph.width == 2) out[col + 1] = Glyph::right_half();
+        col += glyph.width;
+    }
+}
+
+// the text with every placeholder replaced by its first value, padded or cut
+// to the columns it reserves; the fields are listed in `fields` by column
+std::string expand_fields(const std::string& text, MarqueeFont font, std::vector<TextField>& fields) {
+    fields.clear();
+    if (text.find('{') == std::string::npos) return text;
+    std::string shown;
+    int columns = 0;   // strip columns of `shown`
+    auto append = [&shown, &columns, font](const char* bytes, size_t len) {
+        Glyph glyph;
+        for (size_t i = 0; i < len;) {
+            i = next_glyph(bytes, len, i, glyph);
+            columns += font == FONT_BANNER ? BANNER_ADVANCE : glyph.width;
+        }
+        shown.append(bytes, len);
+    };
+    size_t at = 0;
+    while (at < text.size()) {
+        size_t open = text.find('{', at);
+        size_t close = open == std::string::npos ? open : text.find('}', open);
+        if (close == std::string::npos) break;
+        TextField field;
+        std::string name = text.substr(open + 1, close - open - 1);
+        if (name == "time") {
+            field.kind = FIELD_TIME;
+        }
+        else if (name.compare(0, 5, "file:") == 0 && name.size() > 5) {
+            field.kind = FIELD_FILE;
+            field.path = name.substr(5);
+        }
+        else {
+            append(text.data() + at, open + 1 - at); // not a placeholder: the brace is text
+            at = open + 1;
+            continue;
+        }
+        append(text.data() + at, open - at);
+
+        // the first value, cut to whole glyphs within FIELD_MAX_WIDTH columns
+        char value[FIELD_VALUE_BYTES];
+        size_t len = field_value(field, value, sizeof(value));
+        size_t used = 0;
+        int width = 0;
+        Glyph glyph;
+        while (used < len) {
+            size_t next = next_glyph(value, len, used, glyph);
+            if (width + glyph.width > FIELD_MAX_WIDTH) break;
+            width += glyph.width;
+            used = next;
+        }
+        int chars = 0;
+        for (size_t i = 0; i < used; ++chars) i = next_glyph(value, used, i, glyph);
+        if (used == 0) width = chars = FIELD_MISSING_WIDTH;
+
+        field.column = columns;
+        field.width = font == FONT_BANNER ? chars * BANNER_ADVANCE : width;
+        if (used > 0) {
+            append(value, used);
+        }
+        else {
+            shown.append(FIELD_MISSING_WIDTH, ' ');
+            columns += field.width;
+        }
+        fields.push_back(field);
+        at = close + 1;
+    }
+    if (at < text.size()) append(text.data() + at, text.size() - at);
+    return shown;
+}
+
+// --- Marquee text (immutable once published) ---
+// Part of: Marquee Animation Logic
+// Either a fixed text (strip) or a streaming source (feed). Never copied: the
+// last reference to a streamed text stops its feeder thread.
+struct MarqueeText {
+    MarqueeText() {}
+    ~MarqueeText() { if (feed) feed->stop(); }
+
+    std::string text;             // the text as set (placeholders unexpanded), or the source path when streaming
+    MarqueeStrip strip;
+    std::shared_ptr<StreamFeed> feed;
+    std::vector<Attr> attrs;      // rainbow / keyword color per strip column (mirrored like it); empty when uniform
+    std::vector<MarqueeStrip> lower_rows; // banner font: the font rows below the top one (strip holds the top row)
+    std::vector<TextField> fields;        // {time} / {file:...} placeholders, by strip column
+    unsigned version = 0;         // bumped by set_text / set_source / set_font; a width-only rebuild keeps it
+
+    int rows() const { return 1 + static_cast<int>(lower_rows.size()); }
+
+private:
+    MarqueeText(const MarqueeText&) = delete;
+    MarqueeText& operator=(const MarqueeText&) = delete;
+};
+
+// --- Fields in a window ---
+// Part of: Marquee Animation Logic
+// Calls visit(field index, strip column the field starts at) for every field
+// that overlaps the window [pos, pos + width), including the copies in the
+// wrapped tail of the strip. A binary search skips the fields before the window.
+template <typename Visit>
+void for_visible_fields(const MarqueeText& content, int pos, int width, Visit visit) {
+    const std::vector<TextField>& fields = content.fields;
+    if (fields.empty()) return;
+    int end = pos + width;
+    auto first = std::lower_bound(fields.begin(), fields.end(), pos,
+        [](const TextField& field, int column) { return field.column + field.width <= column; });
+    for (auto it = first; it != fields.end() && it->column < end; ++it)
+        visit(static_cast<size_t>(it - fields.begin()), it->column);
+    int cycle = content.strip.cycle;
+    for (auto it = fields.begin(); it != fields.end() && it->column + cycle < end; ++it)
+        visit(static_cast<size_t>(it - fields.begin()), it->column + cycle);
+}
+
+// --- Marquee lane configuration (immutable once published) ---
+// Part of: Marquee Animation Logic
+// What the commands control. The render thread keeps its own per-lane runtime
+// state (Marquee) and applies configuration changes when it sees a new set.
+struct MarqueeConfig {
+    int id = 0;
+    int slot = 0;                 // 0-based first row inside the box (lanes sorted by id)
+    std::shared_ptr<const MarqueeText> content;
+    int speed = 200;              // ms per character (velocity = 1000 / speed chars/s)
+    bool running = false;
+    MarqueeStyle style = STYLE_PLAIN;
+    std::vector<std::string> keywords;  // highlighted by STYLE_KEYWORDS
+    MarqueeFont font = FONT_NORMAL;     // fixed text only; a streamed lane always scrolls one row
+};
+
+const int DEFAULT_LANE = 1;
+const int MAX_LANE_ID = 99;
+const std::chrono::milliseconds LATE_TOLERANCE(2);  // a frame later than this counts as late
+const int DEFAULT_FPS_CAP = 60;
+const int MAX_FPS_CAP = 1000;
+const char* const DEFAULT_MARQUEE_TEXT = " Welcome to CSOPESY Marquee! ";
+
+// --- Published marquee state: every lane plus the render frame cap ---
+struct MarqueeSet {
+    std::vector<MarqueeConfig> lanes;   // sorted by id
+    int fps_cap = DEFAULT_FPS_CAP;
+    unsigned long long version = 0;     // bumped on every publish
+
+    const MarqueeConfig* find(int id) const {
+        for (const MarqueeConfig& lane : lanes)
+            if (lane.id == id) return &lane;
+        return nullptr;
+    }
+    MarqueeConfig* find(int id) {
+        for (MarqueeConfig& lane : lanes)
+            if (lane.id == id) return &lane;
+        return nullptr;
+    }
+};
+
+// --- Per-lane counters published by the render thread ---
+// Part of: Marquee Animation Logic
+// Written only by the render thread, read by the timing command and redraws.
+struct LaneStats {
+    std::atomic<long long> position{ 0 };             // window currently drawn
+    std::atomic<long long> timing_since_ns{ 0 };      // steady_clock time counters were reset
+    std::atomic<unsigned long long> steps{ 0 };       // scroll positions advanced
+    std::atomic<unsigned long long> frames_late{ 0 }; // frames drawn past their deadline
+    std::atomic<unsigned long long> frames_dropped{ 0 }; // positions skipped to catch up
+};
+
+// --- Latest value of a text field (render thread state) ---
+struct FieldValue {
+    std::chrono::steady_clock::time_point next_refresh;
+    std::vector<Glyph> glyphs;    // the field's strip columns on each font row
+};
+
+// --- Marquee lane (render thread state) ---
+// Part of: Marquee Animation Logic
+// One independently scrolling row of the marquee box, addressed by id.
+// The scroll offset is a function of time: phase + elapsed * velocity, so how
+// fast the text moves does not depend on how often frames are rendered.
+struct Marquee {
+    typedef std::chrono::steady_clock Clock;
+
+    int id = 0;
+    int slot = 0;
+    std::shared_ptr<const MarqueeText> content;
+    int speed = 200;
+    MarqueeStyle style = STYLE_PLAIN;
+    long long position = 0;       // window currently drawn (absolute column when streaming)
+    unsigned long long shown_end = 0; // streaming: end of the data drawn in the window
+    bool dirty = true;            // window must be drawn even if the position did not move
+    bool running = false;
+    unsigned generation = 0;      // bumped to cancel ticks that are already scheduled
+    double phase = 0.0;           // scroll offset in characters at phase_origin
+    Clock::time_point phase_origin;
+    std::vector<FieldValue> fields;   // one per content->fields entry
+    Clock::time_point fields_due = Clock::time_point::max(); // next refresh of a visible field
+
+    int cycle() const { return content ? content->strip.cycle : 0; }
+    double velocity() const { return 1000.0 / speed; }
+
+    // unwrapped scroll offset (characters) at time t
+    double scroll_at(Clock::time_point t) const {
+        return phase + std::chrono::duration<double>(t - phase_origin).count() * velocity();
+    }
+
+    // window index shown at time t
+    int position_at(Clock::time_point t) const {
+        if (cycle() == 0) return 0;
+        return static_cast<int>(static_cast<long long>(std::floor(scroll_at(t))) % cycle());
+    }
+
+    // freezes the current offset as the new phase (used on speed change)
+    void rebase(Clock::time_point t) {
+        phase = cycle() > 0 ? std::fmod(scroll_at(t), static_cast<double>(cycle())) : 0.0;
+        phase_origin = t;
+    }
+
+    // first time after t at which the visible window moves
+    Clock::time_point next_step_after(Clock::time_point t) const {
+        double next = std::floor(scroll_at(t)) + 1.0;
+        double seconds = (next - phase) / velocity();
+        return phase_origin + std::chrono::nanoseconds(static_cast<long long>(std::ceil(seconds * 1e9)) + 1);
+    }
+};
+
+// --- Lane scheduler ---
+// Part of: Marquee Animation Logic
+// Min-heap of lane deadlines (the next time each lane's window moves). One
+// thread pops every lane that is due and renders them together in a single
+// frame, never more often than the frame cap allows. A tick remembers the lane
+// generation it was scheduled for, so restarting a lane or changing its speed
+// just leaves the old entry behind to be skipped when it surfaces.
+class MarqueeScheduler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    void schedule(const Marquee& lane, Clock::time_point deadline) {
+        heap.push(Tick{ deadline, lane.id, lane.generation });
+    }
+
+    bool empty() const { return heap.empty(); }
+
+    // when the next frame is due: earliest lane deadline, held back by the frame cap
+    Clock::time_point next_deadline() const { return (std::max)(heap.top().deadline, next_frame); }
+
+    void set_frame_cap(int fps) {
+        if (fps == fps_cap) return;
+        fps_cap = fps;
+        frame_interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+    }
+    int frame_cap() const { return fps_cap; }
+
+    // earliest time the current frame was allowed to start
+    Clock::time_point frame_start() const { return next_frame; }
+    void frame_rendered(Clock::time_point now) { next_frame = now + frame_interval; }
+
+    // pops the earliest tick if it is due at `now`
+    bool pop_due(Clock::time_point now, int& lane_id, unsigned& generation, Clock::time_point& deadline) {
+        if (heap.empty() || heap.top().deadline > now || next_frame > now) return false;
+        lane_id = heap.top().lane_id;
+        generation = heap.top().generation;
+        deadline = heap.top().deadline;
+        heap.pop();
+        return true;
+    }
+
+private:
+    struct Tick {
+        Clock::time_point deadline;
+        int lane_id;
+        unsigned generation;
+
+        bool operator>(const Tick& other) const { return deadline > other.deadline; }
+    };
+
+    std::priority_queue<Tick, std::vector<Tick>, std::greater<Tick>> heap;
+    int fps_cap = DEFAULT_FPS_CAP;
+    Clock::duration frame_interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / DEFAULT_FPS_CAP));
+    Clock::time_point next_frame;
+};
+
+// --- Shared state ---
+// Lock order (command, keyboard and resize threads):
+//   prompt_mutex -> layout_mutex -> marquee_state_mutex -> screen_mutex -> console_mutex
+// The render thread takes no lock on its hot path except try_lock(screen_mutex)
+// (and console_mutex inside it); it reads lanes and layout through snapshots.
+std::atomic<bool> is_running{ true };
+SnapshotCell<MarqueeSet> marquee_set(new MarqueeSet());
+std::mutex marquee_state_mutex;         // serialises writers of marquee_set
+LaneStats lane_stats[MAX_LANE_ID + 1];
+std::atomic<int> current_lane{ DEFAULT_LANE };  // lane shown on the status line
+std::mutex marquee_wake_mutex;
+std::condition_variable marquee_cv;     // wakes the render thread when lanes change
+bool marquee_wake_pending = false;      // guarded by marquee_wake_mutex
+ConsoleLayout layout;                   // guarded by layout_mutex
+SnapshotCell<ConsoleLayout> layout_view(new ConsoleLayout());  // published copy of layout
+std::mutex layout_mutex;
+std::mutex console_mutex;
+std::mutex prompt_mutex;
+std::string prompt_display = ">> ";
+std::atomic<bool> help_visible{ false };
+bool layout_redraw_pending = false;   // command thread: a lane was added or changed height, the batch redraws all of it
+
+// --- Keyboard Handler ---
+enum CommandOrigin {
+    FROM_KEYBOARD,     // typed at the prompt (may be the answer to a set_text/set_speed prompt)
+    FROM_CONTROL,      // sent by a control socket client
+    CONTROL_UPDATES    // apply the coalesced control socket updates
+};
+struct QueuedCommand {
+    std::string line;
+    std::chrono::steady_clock::time_point queued;   // when the keyboard thread read it
+    CommandOrigin origin;
+};
+std::queue<QueuedCommand> command_queue;
+std::mutex command_queue_mutex;
+std::condition_variable command_queue_cv;
+int command_event_fd = -1;   // eventfd the reactor waits on for queued commands (-1: not used)
+
+// latest set_text/set_speed per lane from control socket clients, not yet applied
+struct ControlUpdates {
+    std::map<int, std::string> text;
+    std::map<int, int> speed;
+};
+ControlUpdates control_updates;
+bool control_updates_queued = false;   // a CONTROL_UPDATES command is waiting in command_queue
+std::mutex control_updates_mutex;
+
+// --- Performance counters ---
+// Part of: Thread Synchronization
+// Every thread records into its own ThreadCounters block with relaxed atomics,
+// so recording never takes a lock and threads never contend on a cache line
+// they both write. The stats command sums the blocks when asked.
+
+// log-linear histogram of durations in nanoseconds (4 buckets per power of two)
+class LatencyHistogram {
+public:
+    static const int BUCKETS = 256;
+
+    LatencyHistogram() {
+        for (int i = 0; i < BUCKETS; ++i) buckets[i] = 0;
+    }
+
+    void record(long long ns) {
+        unsigned long long v = ns > 0 ? static_cast<unsigned long long>(ns) : 0;
+        buckets[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        total_ns.fetch_add(v, std::memory_order_relaxed);
+        unsigned long long seen = max_ns.load(std::memory_order_relaxed);
+        while (v > seen && !max_ns.compare_exchange_weak(seen, v, std::memory_order_relaxed)) {}
+    }
+
+    static int bucket_of(unsigned long long v) {
+        if (v < 4) return static_cast<int>(v);
+        int msb = 0;
+        for (unsigned long long t = v; t >>= 1;) ++msb;
+        return 4 * (msb - 1) + static_cast<int>((v >> (msb - 2)) & 3);
+    }
+
+    // largest value that lands in a bucket
+    static unsigned long long bucket_limit(int bucket) {
+        if (bucket < 4) return static_cast<unsigned long long>(bucket);
+        int msb = bucket / 4 + 1;
+        unsigned long long next = static_cast<unsigned long long>(4 + bucket % 4 + 1) << (msb - 2);
+        return next - 1;
+    }
+
+    // starts counting afresh (a record racing with this may survive it)
+    void reset() {
+        for (int i = 0; i < BUCKETS; ++i) buckets[i].store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        total_ns.store(0, std::memory_order_relaxed);
+        max_ns.store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<unsigned long long> buckets[BUCKETS];
+    std::atomic<unsigned long long> count{ 0 };
+    std::atomic<unsigned long long> total_ns{ 0 };
+    std::atomic<unsigned long long> max_ns{ 0 };
+};
+
+struct ThreadCounters {
+    LatencyHistogram frame_time;      // marquee frame: advance + compose + write
+    LatencyHistogram jitter;          // how late a frame started after its deadline
+    LatencyHistogram console_wait;    // time blocked acquiring console_mutex
+    LatencyHistogram layout_wait;     // time blocked acquiring layout_mutex
+    LatencyHistogram command_latency; // command read -> screen updated
+    std::atomic<unsigned long long> frame_bytes{ 0 };
+    std::atomic<unsigned long long> frames_held{ 0 };     // marquee frames dropped while the terminal was behind
+    std::atomic<unsigned long long> queue_depth{ 0 };     // commands taken by the last batch
+    std::atomic<unsigned long long> queue_depth_max{ 0 };
+};
+
+const int MAX_COUNTER_THREADS = 16;
+ThreadCounters thread_counters[MAX_COUNTER_THREADS];
+std::atomic<int> counter_threads{ 0 };
+const std::chrono::steady_clock::time_point process_start = std::chrono::steady_clock::now();
+
+// this thread's counter block (claimed on first use; extra threads share the last one)
+ThreadCounters& my_counters() {
+    thread_local ThreadCounters* mine = nullptr;
+    if (!mine) mine = &thread_counters[(std::min)(counter_threads.fetch_add(1), MAX_COUNTER_THREADS - 1)];
+    return *mine;
+}
+
+// --- Low-jitter mode (--low-jitter <cpu> [--realtime], Linux) ---
+// Part of: Thread Synchronization
+// The request is set from the command line before any thread starts. The
+// marquee thread applies it to itself (see enter_low_jitter_mode) and records
+// what it was refused; `jitter` shows both next to the histogram.
+const int LOW_JITTER_RT_PRIORITY = 10;    // SCHED_FIFO priority: above every normal thread, well below kernel threads
+const int LOW_JITTER_SPIN_US = 200;       // the last stretch before a deadline is spun instead of slept
+const size_t LOW_JITTER_STACK_BYTES = 64 * 1024;  // stack faulted in ahead of the frame path
+
+struct LowJitterMode {
+    bool enabled = false;
+    int cpu = 0;
+    bool realtime = false;        // ask for SCHED_FIFO; the thread stays SCHED_OTHER when refused
+    std::atomic<bool> applied{ false };  // the errors below are written once, before this is set
+    int pin_error = 0;
+    int realtime_error = 0;
+    int lock_error = 0;
+};
+LowJitterMode low_jitter;
+
+long long elapsed_ns(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+// --- lock_guard that records how long the lock took to get ---
+// An uncontended lock is counted as a zero wait without reading the clock.
+class CountedLock {
+public:
+    CountedLock(std::mutex& m, LatencyHistogram ThreadCounters::* wait) : m(m) {
+        if (m.try_lock()) {
+            (my_counters().*wait).record(0);
+            return;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        m.lock();
+        (my_counters().*wait).record(elapsed_ns(start));
+    }
+    ~CountedLock() { m.unlock(); }
+
+private:
+    CountedLock(const CountedLock&) = delete;
+    CountedLock& operator=(const CountedLock&) = delete;
+
+    std::mutex& m;
+};
+
+// --- Terminal helpers ---
+void enable_ansi_on_windows() {
+#ifdef _WIN32
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (hOut == INVALID_HANDLE_VALUE) return;
+    DWORD mode = 0;
+    if (!GetConsoleMode(hOut, &mode)) return;
+    mode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
+    SetConsoleMode(hOut, mode);
+
+    // marquee text is UTF-8
+    SetConsoleOutputCP(CP_UTF8);
+    SetConsoleCP(CP_UTF8);
+#endif
+}
+
+// --- Get current console size ---
+int fixed_console_width = 0;    // non-zero: a replay run pins the console size
+int fixed_console_height = 0;
+
+void get_console_size(int& width, int& height) {
+    if (fixed_console_width > 0 && fixed_console_height > 0) {
+        width = fixed_console_width;
+        height = fixed_console_height;
+        return;
+    }
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (GetConsoleScreenBufferInfo(hOut, &csbi)) {
+        width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+        height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+    }
+    else {
+        width = 120;
+        height = 30;
+    }
+#else
+    // ask the tty; stdout may be redirected, so fall back to stdin
+    struct winsize ws;
+    if ((ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 || ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) == 0)
+        && ws.ws_col > 0 && ws.ws_row > 0) {
+        width = ws.ws_col;
+        height = ws.ws_row;
+    }
+    else {
+        width = 120;
+        height = 30;
+    }
+#endif
+}
+
+// --- Wake the render thread after publishing a change ---
+// Part of: Marquee Animation Logic
+void wake_marquee_thread() {
+    {
+        std::lock_guard<std::mutex> lock(marquee_wake_mutex);
+        marquee_wake_pending = true;
+    }
+    marquee_cv.notify_one();
+}
+
+// --- Copy the current marquee set for modification ---
+// caller holds marquee_state_mutex (so no other writer publishes in between)
+std::unique_ptr<MarqueeSet> edit_marquee_set() {
+    SnapshotCell<MarqueeSet>::Read current = marquee_set.read();
+    std::unique_ptr<MarqueeSet> next(new MarqueeSet(*current));
+    ++next->version;
+    return next;
+}
+
+// --- Forget cached {file:} values no lane's text names any more ---
+// caller holds marquee_state_mutex (so the published lanes stay as they are)
+void prune_file_fields() {
+    SnapshotCell<MarqueeSet>::Read lanes = marquee_set.read();
+    file_fields().prune([&lanes](const std::string& path) {
+        for (const MarqueeConfig& lane : lanes->lanes)
+            for (const TextField& field : lane.content->fields)
+                if (field.kind == FIELD_FILE && field.path == path) return true;
+        return false;
+    });
+}
+
+// --- Render a text through the banner font ---
+// Part of: Marquee Animation Logic
+// Every glyph of the text becomes BANNER_ADVANCE columns on each font row;
+// the row strips are padded and wrapped like a one-row strip, so a frame is
+// BANNER_ROWS contiguous window copies.
+void build_banner(MarqueeText& content, const std::string& text, int width) {
+    content.lower_rows.assign(BANNER_ROWS - 1, MarqueeStrip());
+    for (int row = 0; row < BANNER_ROWS; ++row) {
+        MarqueeStrip& strip = row == 0 ? content.strip : content.lower_rows[row - 1];
+        strip.width = (std::max)(width, 0);
+        strip.columns.clear();
+        for (size_t i = 0; i < text.size();) {
+            Glyph glyph;
+            i = next_glyph(text.data(), text.size(), i, glyph);
+            const unsigned char* columns = banner_glyph(glyph);
+            for (int c = 0; c < BANNER_COLUMNS; ++c) strip.columns.push_back(banner_cell(columns, c, row));
+            strip.columns.resize(strip.columns.size() + (BANNER_ADVANCE - BANNER_COLUMNS), Glyph());
+        }
+        strip.wrap();
+    }
+}
+
+// --- Stack the lanes inside the marquee box ---
+// Part of: Marquee Animation Logic
+// Lanes sit in id order; a lane's slot is its first row in the box, and a
+// fixed text in the banner font takes BANNER_ROWS rows. The lanes get their
+// rows before the help list: the box shows as many rows as fit above the status
+// line, the help heading, one row of command names and the prompt (18 rows
+// besides the box itself, header included); the help list shrinks instead.
+int box_rows(const MarqueeSet& set, int screen_height) {
+    int rows = set.lanes.empty() ? 0 : set.lanes.back().slot + set.lanes.back().content->rows();
+    int max_rows = (std::max)(1, screen_height - 19);
+    return (std::max)(1, (std::min)(rows, max_rows));
+}
+
+// caller holds layout_mutex; returns true when a lane moved or the box changed
+// height (the whole UI needs a redraw)
+bool assign_slots(MarqueeSet& set) {
+    bool moved = false;
+    int row = 0;
+    for (MarqueeConfig& lane : set.lanes) {
+        moved |= lane.slot != row;
+        lane.slot = row;
+        row += lane.content->rows();
+    }
+    return moved || box_rows(set, layout.screen_height) != layout.marquee_rows;
+}
+
+// --- Lay out the per-column colors of a text strip ---
+// Part of: Marquee Animation Logic
+// Walks the text glyph by glyph like MarqueeStrip::build so every column gets
+// the color of the bytes it came from (a banner glyph colors all its columns,
+// on every font row). Keywords match ASCII case-insensitively.
+void build_strip_attrs(MarqueeText& content, const std::string& text, MarqueeStyle style, const std::vector<std::string>& keywords) {
+    content.attrs.clear();
+    if (style != STYLE_RAINBOW && style != STYLE_KEYWORDS) return;
+    std::vector<bool> highlight;
+    if (style == STYLE_KEYWORDS) {
+        highlight.assign(text.size(), false);
+        for (const std::string& word : keywords) {
+            if (word.empty() || word.size() > text.size()) continue;
+            for (size_t at = 0; at + word.size() <= text.size(); ++at) {
+                size_t i = 0;
+                while (i < word.size() && tolower(static_cast<unsigned char>(text[at + i])) == tolower(static_cast<unsigned char>(word[i]))) ++i;
+                if (i == word.size()) std::fill(highlight.begin() + at, highlight.begin() + at + word.size(), true);
+            }
+        }
+    }
+
+    const MarqueeStrip& strip = content.strip;
+    content.attrs.reserve(strip.columns.size());
+    for (size_t i = 0; i < text.size();) {
+        Glyph glyph;
+        size_t next = next_glyph(text.data(), text.size(), i, glyph);
+        Attr attr = style == STYLE_RAINBOW
+            ? rainbow_run.attr[content.attrs.size() % RAINBOW_PERIOD]
+            : (highlight[i] ? KEYWORD_ATTR : Attrs::WHITE);
+        int columns = content.lower_rows.empty() ? glyph.width : BANNER_ADVANCE;
+        content.attrs.insert(content.attrs.end(), static_cast<size_t>(columns), attr);
+        i = next;
+    }
+    content.attrs.resize(static_cast<size_t>(strip.cycle), Attrs::WHITE);
+    for (int i = 0; i < strip.width; ++i) content.attrs.push_back(content.attrs[i]);
+}
+
+// --- Build the text content of a lane for a marquee width ---
+std::shared_ptr<const MarqueeText> make_marquee_text(const std::string& text, int width, unsigned version,
+                                                     MarqueeStyle style, const std::vector<std::string>& keywords,
+                                                     MarqueeFont font) {
+    std::shared_ptr<MarqueeText> content = std::make_shared<MarqueeText>();
+    content->text = text;
+    std::string shown = expand_fields(text, font, content->fields);
+    if (font == FONT_BANNER)
+        build_banner(*content, shown, width);
+    else
+        content->strip.build(shown, width);
+    build_strip_attrs(*content, shown, style, keywords);
+    content->version = version;
+    return content;
+}
+
+// --- Gradient colors for a marquee width ---
+std::vector<Attr> make_gradient(int width) {
+    std::vector<Attr> gradient(static_cast<size_t>((std::max)(width, 0)));
+    for (int c = 0; c < width; ++c) gradient[c] = gradient_colors[c * GRADIENT_STEPS / width];
+    return gradient;
+}
+
+// --- Lay the console out for a given size ---
+// Part of: Console UI Implementation
+void apply_layout(int width, int height) {
+    CountedLock lock(layout_mutex, &ThreadCounters::layout_wait);
+    layout.screen_width = width;
+    layout.screen_height = height;
+
+    // adjust ONLY marquee width based on screen width (but keep reasonable limits)
+    layout.marquee_width = (std::min)((std::max)(41, layout.screen_width - 20), layout.screen_width - 4);
+
+    std::lock_guard<std::mutex> state_lock(marquee_state_mutex);
+    std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+
+    // the box grows to the rows of all lanes
+    layout.marquee_rows = box_rows(*lanes, layout.screen_height);
+    int extra_lanes = layout.marquee_rows - 1;
+
+    // keep ALL elements FIXED - wag palitan based on screen size (only extra lanes push them down)
+    layout.marquee_top_row = 2;                        // FIXED
+    layout.marquee_text_row = 3;                       // FIXED  
+    layout.marquee_bottom_row = 4 + extra_lanes;       // FIXED
+    layout.status_row = 6 + extra_lanes;               // FIXED
+    layout.help_row = 7 + extra_lanes;                 // FIXED
+    // below the help list, but the prompt (drawn 2 rows lower) stays above the last
+    // terminal row: the newline echoed after a command lands there, and one row
+    // more would scroll the whole UI up. The help list collapses to fit (see draw_help_line).
+    layout.prompt_row = (std::max)(layout.help_row + 9,
+        (std::min)(layout.help_row + 9 + help_entry_count, layout.screen_height - 3));
+    layout.prompt_col = 1;                             // FIXED
+
+    // the scroll strips and the gradient depend on the window width
+    if (static_cast<int>(layout.gradient.size()) != layout.marquee_width) layout.gradient = make_gradient(layout.marquee_width);
+    bool rebuilt = false;
+    for (MarqueeConfig& lane : lanes->lanes) {
+        if (lane.content->feed) {
+            lane.content->feed->set_padding(layout.marquee_width); // streams read the width per frame
+            continue;
+        }
+        if (lane.content->strip.width != layout.marquee_width) {
+            lane.content = make_marquee_text(lane.content->text, layout.marquee_width, lane.content->version, lane.style, lane.keywords, lane.font);
+            rebuilt = true;
+        }
+    }
+    layout_view.publish(std::unique_ptr<ConsoleLayout>(new ConsoleLayout(layout)));
+    if (rebuilt) {
+        marquee_set.publish(std::move(lanes));
+        wake_marquee_thread();
+    }
+}
+
+// --- Update layout based on current console size ---
+// Part of: Console UI Implementation
+void update_layout() {
+    int width = 0, height = 0;
+    get_console_size(width, height);
+    apply_layout(width, height);
+}
+
+// --- Frame composition ---
+// Part of: Console UI Implementation
+// Collects the cursor moves, colors and text of one screen update into a
+// reusable byte buffer so the whole update leaves with a single write.
+class FrameBuffer {
+public:
+    void clear() { bytes.clear(); }
+    bool empty() const { return bytes.empty(); }
+    const char* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+
+    // 1-based column/row, formatted without going through printf
+    void move_to(int col, int row) {
+        if (row < 1) row = 1;
+        if (col < 1) col = 1;
+        char seq[24];
+        int n = 0;
+        seq[n++] = '\033';
+        seq[n++] = '[';
+        n += format_int(seq + n, row);
+        seq[n++] = ';';
+        n += format_int(seq + n, col);
+        seq[n++] = 'H';
+        bytes.append(seq, n);
+    }
+
+    // grows the buffer to n bytes and touches them, so frames up to that size never page-fault
+    void prefault(size_t n) {
+        bytes.assign(n, '\0');
+        bytes.clear();
+    }
+
+    void save_cursor() { bytes.append("\033[s", 3); }
+    void restore_cursor() { bytes.append("\033[u", 3); }
+
+    void put(const std::string& s) { bytes.append(s); }
+    void put(const char* s, size_t len) { bytes.append(s, len); }
+    void put(const char* s) { bytes.append(s); }
+    void put(int value) {
+        char digits[16];
+        bytes.append(digits, format_int(digits, value));
+    }
+    void fill(char c, int count) {
+        if (count > 0) bytes.append(static_cast<size_t>(count), c);
+    }
+
+private:
+    static int format_int(char* out, int value) {
+        char tmp[12];
+        int n = 0;
+        unsigned int v = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+        do {
+            tmp[n++] = static_cast<char>('0' + v % 10);
+            v /= 10;
+        } while (v != 0);
+        int len = 0;
+        if (value < 0) out[len++] = '-';
+        while (n > 0) out[len++] = tmp[--n];
+        return len;
+    }
+
+    std::string bytes;
+};
+
+// each thread composes into its own buffer; capacity is kept between frames
+thread_local FrameBuffer ui_frame;
+
+// --- Output sinks ---
+// Part of: Console UI Implementation
+// Where composed frames go. The console sink writes to the terminal; the null
+// and memory sinks let frames be rendered and measured without one. Counters
+// are updated under console_mutex.
+class OutputSink {
+public:
+    virtual ~OutputSink() {}
+    virtual void write(const char* data, size_t len) = 0;
+
+    unsigned long long bytes_written = 0;
+    unsigned long long syscalls = 0;   // write calls that reached the OS
+};
+
+#ifndef _WIN32
+// write() until everything is out; returns the number of write calls made
+unsigned long long write_all(int fd, const char* p, size_t left) {
+    unsigned long long calls = 0;
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        ++calls;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    return calls;
+}
+#endif
+
+class ConsoleSink : public OutputSink {
+public:
+    void write(const char* data, size_t len) override {
+#ifdef _WIN32
+        fwrite(data, 1, len, stdout);
+        fflush(stdout);
+        ++syscalls;
+#else
+        fflush(stdout); // anything still buffered by std::cout/printf goes first
+        syscalls += write_all(STDOUT_FILENO, data, len);
+#endif
+        bytes_written += len;
+    }
+};
+
+// discards frames through the OS, so the write cost is still paid
+class NullSink : public OutputSink {
+public:
+#ifdef _WIN32
+    NullSink() : file(fopen("NUL", "wb")) {}
+    ~NullSink() { if (file) fclose(file); }
+    void write(const char* data, size_t len) override {
+        if (file) {
+            fwrite(data, 1, len, file);
+            fflush(file);
+        }
+        ++syscalls;
+        bytes_written += len;
+    }
+private:
+    FILE* file;
+#else
+    NullSink() : fd(::open("/dev/null", O_WRONLY | O_CLOEXEC)) {}
+    ~NullSink() { if (fd >= 0) ::close(fd); }
+    void write(const char* data, size_t len) override {
+        if (fd >= 0) syscalls += write_all(fd, data, len);
+        bytes_written += len;
+    }
+private:
+    int fd;
+#endif
+};
+
+// keeps the bytes of the last frames in memory (no OS calls at all)
+class MemorySink : public OutputSink {
+public:
+    void write(const char* data, size_t len) override {
+        captured.append(data, len);
+        bytes_written += len;
+    }
+
+    std::string captured;
+};
+
+// appends frames to a file through stdio buffering (write calls are not counted)
+class FileSink : public OutputSink {
+public:
+    explicit FileSink(const char* path) : file(fopen(path, "wb")) {}
+    ~FileSink() { if (file) fclose(file); }
+    bool is_open() const { return file != nullptr; }
+    void write(const char* data, size_t len) override {
+        if (file) fwrite(data, 1, len, file);
+        bytes_written += len;
+    }
+
+private:
+    FILE* file;
+};
+
+ConsoleSink console_sink;
+OutputSink* output_sink = &console_sink;   // swapped before any thread starts
+
+// --- Send a composed frame to the output sink with one write ---
+// Part of: Console UI Implementation
+void flush_frame(FrameBuffer& frame) {
+    if (frame.empty()) return;
+    {
+        CountedLock lock(console_mutex, &ThreadCounters::console_wait);
+        output_sink->write(frame.data(), frame.size());
+    }
+    frame.clear();
+}
+
+// --- Clear screen ---
+// Part of: Console UI Implementation
+void clear_screen() {
+    FrameBuffer& frame = ui_frame;
+    frame.put("\033[2J\033[H");
+    flush_frame(frame);
+}
+
+// --- Emit the SGR change from one attribute to another ---
+// Part of: Console UI Implementation
+// Either the changed parameters alone ("22;93") or a reset followed by the
+// target ("0;93"), whichever is shorter.
+int sgr_foreground(char* out, int fg) {
+    if (fg == 0) return snprintf(out, 8, "39");
+    if (fg <= 8) return snprintf(out, 8, "%d", 29 + fg);
+    if (fg <= 16) return snprintf(out, 8, "%d", 81 + fg);
+    return snprintf(out, 12, "38;5;%d", fg - Attrs::PALETTE);
+}
+
+void put_sgr(FrameBuffer& out, Attr from, Attr to) {
+    if (from == to) return;
+    if (to == Attrs::RESET) {
+        out.put("\033[0m", 4);
+        return;
+    }
+    int fg = to & Attrs::FG_MASK;
+    bool bold = (to & Attrs::BOLD) != 0;
+    char delta[24], reset[24];
+    int d = 0, r = 0;
+    if (bold != ((from & Attrs::BOLD) != 0)) d += snprintf(delta, sizeof(delta), bold ? "1;" : "22;");
+    if (fg != (from & Attrs::FG_MASK)) d += sgr_foreground(delta + d, fg) + 1;
+    r += snprintf(reset, sizeof(reset), bold ? "0;1;" : "0;");
+    if (fg != 0) r += sgr_foreground(reset + r, fg) + 1;
+    const char* params = d <= r ? delta : reset;
+    out.put("\033[", 2);
+    out.put(params, static_cast<size_t>((d <= r ? d : r) - 1)); // drop the trailing ';'
+    out.put("m", 1);
+}
+
+// --- Screen cell ---
+struct Cell {
+    Glyph glyph;
+    Attr attr = Attrs::RESET;
+
+    bool operator==(const Cell& other) const { return glyph == other.glyph && attr == other.attr; }
+    bool operator!=(const Cell& other) const { return !(*this == other); }
+
+    // a space looks the same in every foreground color (no backgrounds are used)
+    bool blank() const { return glyph == Glyph(); }
+    bool looks_like(const Cell& other) const { return glyph == other.glyph && (attr == other.attr || blank()); }
+};
+
+// --- Double-buffered cell grid ---
+// Part of: Display Implementation
+// Everything is drawn into the back grid. present() compares it against the
+// front grid (what the terminal currently shows) and emits only the cells that
+// changed, merged into runs, then copies them to the front grid.
+class ScreenGrid {
+public:
+    int width() const { return w; }
+    int height() const { return h; }
+
+    // resizes both grids; the terminal content is unknown afterwards
+    void resize(int width, int height) {
+        w = (std::max)(width, 1);
+        h = (std::max)(height, 1);
+        front.assign(static_cast<size_t>(w) * h, Cell());
+        back.assign(static_cast<size_t>(w) * h, Cell());
+        row_dirty.assign(h, 1);
+        row_erase.assign(h, 0);
+        invalidate_all();
+    }
+
+    // true when the terminal can change to this size without rewrapping or
+    // scrolling anything drawn on it: nothing lies beyond the new width or height
+    bool keeps_content(int width, int height) const {
+        for (int row = 1; row <= h; ++row) {
+            const Cell* f = &front[index(1, row)];
+            for (int c = row <= height ? (std::max)(width, 0) : 0; c < w; ++c)
+                if (!f[c].blank()) return false;
+        }
+        return true;
+    }
+
+    // changes the size keeping both grids where they are still on screen (the
+    // terminal keeps that part too, see keeps_content); new cells are blank
+    void reshape(int width, int height) {
+        width = (std::max)(width, 1);
+        height = (std::max)(height, 1);
+        std::vector<Cell> new_front(static_cast<size_t>(width) * height, Cell());
+        std::vector<Cell> new_back(static_cast<size_t>(width) * height, Cell());
+        int shared = (std::min)(w, width);
+        for (int row = 1; row <= (std::min)(h, height); ++row) {
+            std::copy(front.begin() + index(1, row), front.begin() + index(1, row) + shared, new_front.begin() + static_cast<size_t>(row - 1) * width);
+            std::copy(back.begin() + index(1, row), back.begin() + index(1, row) + shared, new_back.begin() + static_cast<size_t>(row - 1) * width);
+        }
+        front.swap(new_front);
+        back.swap(new_back);
+        row_dirty.resize(height, 0);
+        row_erase.resize(height, 0);
+        w = width;
+        h = height;
+        // a wide glyph cut by the new right edge: blank in the grid, unknown on the terminal
+        for (int row = 1; row <= h; ++row) {
+            if (back[index(w, row)].glyph.width == 2) {
+                back[index(w, row)].glyph = Glyph();
+                row_dirty[row - 1] = 1;
+            }
+            if (front[index(w, row)].glyph.width == 2) invalidate_row(row);
+        }
+    }
+
+    // next present() starts from a cleared terminal
+    void invalidate_all() { full_clear = true; }
+
+    // terminal row was touched behind our back (e.g. echoed input); wipe it on next present()
+    void invalidate_row(int row) {
+        if (row < 1 || row > h) return;
+        row_erase[row - 1] = 1;
+        row_dirty[row - 1] = 1;
+    }
+
+    void clear() {
+        for (int row = 1; row <= h; ++row) clear_row(row);
+    }
+
+    void clear_row(int row) { fill(1, row, w, ' ', Attrs::RESET); }
+
+    void fill(int col, int row, int count, char glyph, Attr attr) {
+        if (row < 1 || row > h || col > w) return;
+        if (col < 1) { count += col - 1; col = 1; }
+        count = (std::min)(count, w - col + 1);
+        if (count <= 0) return;
+        split_wide(row, col, col + count);
+        Cell* cell = &back[index(col, row)];
+        for (int i = 0; i < count; ++i) {
+            cell[i].glyph = Glyph::ascii(glyph);
+            cell[i].attr = attr;
+        }
+        row_dirty[row - 1] = 1;
+    }
+
+    // UTF-8 text; returns the column after the last cell written
+    int put(int col, int row, const char* text, size_t len, Attr attr) {
+        if (row < 1 || row > h) return col;
+        int start = col;
+        Glyph glyph;
+        for (size_t i = 0; i < len;) {
+            i = next_glyph(text, len, i, glyph);
+            if (col >= 1 && col + glyph.width - 1 <= w) {
+                split_wide(row, col, col + glyph.width);
+                Cell* cell = &back[index(col, row)];
+                cell[0].glyph = glyph;
+                cell[0].attr = attr;
+                if (glyph.width == 2) {
+                    cell[1].glyph = Glyph::right_half();
+                    cell[1].attr = attr;
+                }
+            }
+            col += glyph.width;
+        }
+        if (col != start) row_dirty[row - 1] = 1;
+        return col;
+    }
+
+    int put(int col, int row, const std::string& text, Attr attr) {
+        return put(col, row, text.data(), text.size(), attr);
+    }
+
+    // copies columns that were split up front (see MarqueeStrip); no decoding.
+    // A wide glyph cut in half by either edge is shown as a space. `attrs`,
+    // when given, holds one attribute per column and replaces `attr`.
+    void put_glyphs(int col, int row, const Glyph* glyphs, int count, Attr attr, const Attr* attrs = nullptr) {
+        if (row < 1 || row > h || col < 1 || col > w) return;
+        count = (std::min)(count, w - col + 1);
+        if (count <= 0) return;
+        split_wide(row, col, col + count);
+        Cell* cell = &back[index(col, row)];
+        for (int i = 0; i < count; ++i) {
+            cell[i].glyph = glyphs[i];
+            cell[i].attr = attrs ? attrs[i] : attr;
+        }
+        if (cell[0].glyph.width == 0) cell[0].glyph = Glyph();
+        if (cell[count - 1].glyph.width == 2) cell[count - 1].glyph = Glyph();
+        row_dirty[row - 1] = 1;
+    }
+
+    // appends the escape sequences that bring the terminal from front to back;
+    // returns false (and appends nothing) when nothing changed
+    bool present(FrameBuffer& out) {
+        const size_t start = out.size();
+        Attr current = Attrs::RESET; // every present ends with attributes reset
+        int cursor_row = 0, cursor_col = 0; // 0 = unknown
+
+        if (full_clear) {
+            out.put("\033[0m\033[2J", 8);
+            std::fill(front.begin(), front.end(), Cell());
+            std::fill(row_dirty.begin(), row_dirty.end(), 1); // every row is written again
+            full_clear = false;
+        }
+
+        for (int row = 1; row <= h; ++row) {
+            if (!row_dirty[row - 1]) continue;
+            row_dirty[row - 1] = 0;
+
+            Cell* f = &front[index(1, row)];
+            const Cell* b = &back[index(1, row)];
+            if (row_erase[row - 1]) {
+                row_erase[row - 1] = 0;
+                out.move_to(1, row);
+                out.put("\033[2K", 4);
+                std::fill(f, f + w, Cell());
+                cursor_row = row;
+                cursor_col = 1;
+            }
+
+            // blank cells from here to the end of the row can be erased instead of written
+            int blank_tail = w;
+            while (blank_tail > 0 && b[blank_tail - 1].blank()) --blank_tail;
+
+            int col = 0;
+            while (col < w) {
+                if (b[col].looks_like(f[col])) { ++col; continue; }
+
+                if (col >= blank_tail) {
+                    int last = w - 1;
+                    while (b[last].looks_like(f[last])) --last;
+                    if (last - col >= ERASE_MIN) {
+                        // erasing only uses the background color, which is never set
+                        if (cursor_row != row || cursor_col != col + 1) out.move_to(col + 1, row);
+                        out.put("\033[K", 3);
+                        std::fill(f + col, f + w, Cell());
+                        break;
+                    }
+                }
+
+                // extend the run; short unchanged gaps are cheaper to rewrite than to jump over
+                int end = col + 1;
+                int gap = 0;
+                for (int c = end; c < (col < blank_tail ? blank_tail : w); ++c) {
+                    if (!b[c].looks_like(f[c])) { end = c + 1; gap = 0; }
+                    else if (++gap > MERGE_GAP) break;
+                }
+
+                // a wide glyph is always written whole
+                if (col > 0 && b[col].glyph.width == 0) --col;
+                if (end < w && b[end - 1].glyph.width == 2) ++end;
+
+                if (cursor_row != row || cursor_col != col + 1) out.move_to(col + 1, row);
+                for (int c = col; c < end; ++c) {
+                    // only the changes between neighbouring cells; spaces keep whatever is set
+                    if (b[c].attr != current && !b[c].blank()) {
+                        put_sgr(out, current, b[c].attr);
+                        current = b[c].attr;
+                    }
+                    out.put(b[c].glyph.bytes, b[c].glyph.len);
+                    f[c] = b[c];
+                }
+                cursor_row = row;
+                cursor_col = end + 1;
+                if (end >= w) cursor_row = 0; // pending autowrap, position unknown
+                col = end;
+            }
+        }
+
+        put_sgr(out, current, Attrs::RESET);
+        return out.size() != start;
+    }
+
+    // what the terminal shows, as one self-contained update (for an output that lost track)
+    void keyframe(FrameBuffer& out) const {
+        out.put("\033[0m\033[2J", 8);
+        Attr current = Attrs::RESET;
+        for (int row = 1; row <= h; ++row) {
+            const Cell* f = &front[index(1, row)];
+            int end = w;
+            while (end > 0 && f[end - 1].blank()) --end;
+            int col = 0;
+            while (col < end && f[col].blank()) ++col;
+            if (col == end) continue;
+            out.move_to(col + 1, row);
+            for (; col < end; ++col) {
+                if (f[col].attr != current && !f[col].blank()) {
+                    put_sgr(out, current, f[col].attr);
+                    current = f[col].attr;
+                }
+                out.put(f[col].glyph.bytes, f[col].glyph.len);
+            }
+        }
+        put_sgr(out, current, Attrs::RESET);
+    }
+
+    // draws what another grid's terminal shows, clipped or padded to this size
+    void follow(const ScreenGrid& source) {
+        for (int row = 1; row <= h; ++row) {
+            Cell* b = &back[index(1, row)];
+            int shared = row <= source.h ? (std::min)(w, source.w) : 0;
+            const Cell* s = shared > 0 ? &source.front[source.index(1, row)] : nullptr;
+            bool changed = false;
+            for (int c = 0; c < w; ++c) {
+                Cell cell = c < shared ? s[c] : Cell();
+                if (c == shared - 1 && shared < source.w && cell.glyph.width == 2) cell = Cell(); // cut by the edge
+                if (b[c] != cell) {
+                    b[c] = cell;
+                    changed = true;
+                }
+            }
+            if (changed) row_dirty[row - 1] = 1;
+        }
+    }
+
+private:
+    static const int MERGE_GAP = 3;
+    static const int ERASE_MIN = 3;
+
+    size_t index(int col, int row) const { return static_cast<size_t>(row - 1) * w + (col - 1); }
+
+    // columns [first, end) are about to be overwritten: blank the other half of
+    // any wide glyph that straddles either edge
+    void split_wide(int row, int first, int end) {
+        Cell* cells = &back[index(1, row)];
+        if (first > 1 && cells[first - 1].glyph.width == 0) cells[first - 2].glyph = Glyph();
+        if (end <= w && cells[end - 1].glyph.width == 0) cells[end - 1].glyph = Glyph();
+    }
+
+    int w = 0;
+    int h = 0;
+    std::vector<Cell> front;
+    std::vector<Cell> back;
+    std::vector<unsigned char> row_dirty;
+    std::vector<unsigned char> row_erase;
+    bool full_clear = true;
+};
+
+// --- Writer sink: terminal and mirror output on its own thread (threaded mode) ---
+// Part of: Console UI Implementation
+// A producer appends its frame to a pending buffer under console_mutex and
+// returns. The writer thread swaps the buffers out and writes them without
+// blocking and with no lock held, so a slow terminal (a poor SSH link, a paused
+// tmux pane) never blocks a producer. Whatever an output does not take stays in
+// its own backlog and is retried every OUTPUT_RETRY_MS. The buffers keep their
+// capacity, so steady output allocates nothing.
+//
+// The render thread only presents while the console has nothing pending: when
+// the terminal falls behind it keeps drawing into the back grid, and the frame
+// it presents once the writer catches up is the newest one, so the frames in
+// between are dropped without ever being encoded. Status and prompt updates are
+// always appended. If a stuck terminal still lets the backlog pass the cap, it
+// is discarded and the render thread repaints the whole screen.
+//
+// Mirrors (--mirror) are extra ptys, FIFOs or files that show the same screen.
+// Each frame is composed once per stream: mirrors of the console's size are
+// sent the very bytes composed for the console (vectored writes, no copies
+// unless a mirror falls behind), and a pty of another size joins a size
+// group whose own grid follows the console grid, clipped or padded. The console
+// sets the pace; a mirror never slows it down. A mirror that falls more than
+// MIRROR_BACKLOG_CAP behind drops its backlog and resumes from a keyframe (the
+// whole screen), composed at the next present.
+class WriterSink : public OutputSink {
+public:
+    static const size_t PENDING_CAP = 4 << 20;
+    static const size_t MIRROR_BACKLOG_CAP = 1 << 20;
+    static const int OUTPUT_RETRY_MS = 10;   // how often an output with a backlog is written again
+    static const int STOP_DRAIN_MS = 1000;   // how long exit waits for a slow terminal
+
+    // one destination of a stream
+    struct Output {
+        int fd = -1;
+        std::string path;
+        bool console = false;             // stdout: never resynced, paces the render thread
+        bool resync = false;              // dropped its backlog; waits for a keyframe (writer thread)
+        std::string backlog;              // bytes it has not taken yet (writer thread)
+        std::atomic<unsigned long long> sent{ 0 };
+        std::atomic<unsigned long long> resyncs{ 0 };
+        std::atomic<unsigned long long> behind{ 0 };   // backlog size
+    };
+
+    // bytes composed once for every output of one size
+    struct Stream {
+        int width = 0;                    // 0: follows the console size
+        int height = 0;
+        ScreenGrid grid;                  // size groups: clipped / padded copy of the console grid
+        FrameBuffer frame;                // composing buffer (screen_mutex)
+        std::string pending;              // console_mutex
+        std::string writing;              // writer thread
+        std::string keyframe;             // console_mutex: whole screen, followed by pending[keyframe_at..]
+        std::string keyframe_writing;     // writer thread
+        size_t keyframe_at = 0;
+        size_t keyframe_writing_at = 0;
+        bool keyframe_ready = false;
+        bool keyframe_writing_ready = false;
+        std::atomic<bool> wants_keyframe{ false };
+        std::vector<Output*> outputs;
+    };
+
+    WriterSink() {
+        streams.emplace_back(new Stream());
+        Output* console = new Output();
+        console->console = true;
+        console->path = "console";
+#ifndef _WIN32
+        console->fd = STDOUT_FILENO;
+#endif
+        outputs.emplace_back(console);
+        streams[0]->outputs.push_back(console);
+    }
+
+#ifndef _WIN32
+    // before start(): a terminal of another size than the console gets its own
+    // size group; FIFOs (with a reader) and files follow the console. Returns
+    // false with errno set when the path cannot be opened.
+    bool add_mirror(const std::string& path, int console_width, int console_height) {
+        struct stat info;
+        bool exists = ::stat(path.c_str(), &info) == 0;
+        int flags = O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC;
+        if (!exists || S_ISREG(info.st_mode)) flags |= O_CREAT | O_TRUNC;
+        int fd = ::open(path.c_str(), flags, 0644);
+        if (fd < 0) return false;
+
+        int width = 0, height = 0;
+        struct winsize size;
+        if (isatty(fd) && ioctl(fd, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0 &&
+            (size.ws_col != console_width || size.ws_row != console_height)) {
+            width = size.ws_col;
+            height = size.ws_row;
+        }
+        Stream* stream = nullptr;
+        for (const std::unique_ptr<Stream>& candidate : streams)
+            if (candidate->width == width && candidate->height == height) stream = candidate.get();
+        if (!stream) {
+            stream = new Stream();
+            stream->width = width;
+            stream->height = height;
+            stream->grid.resize(width, height);
+            streams.emplace_back(stream);
+        }
+        Output* output = new Output();
+        output->fd = fd;
+        output->path = path;
+        outputs.emplace_back(output);
+        stream->outputs.push_back(output);
+        return true;
+    }
+#endif
+
+    void start() {
+#ifndef _WIN32
+        stdout_flags = fcntl(STDOUT_FILENO, F_GETFL);
+        fcntl(STDOUT_FILENO, F_SETFL, stdout_flags | O_NONBLOCK);
+#endif
+        thread = std::thread(&WriterSink::run, this);
+    }
+
+    // writes what is still pending, giving up on outputs that stay stuck
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(console_mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        if (thread.joinable()) thread.join();
+#ifndef _WIN32
+        fcntl(STDOUT_FILENO, F_SETFL, stdout_flags);
+        for (const std::unique_ptr<Output>& output : outputs)
+            if (!output->console && output->fd >= 0) ::close(output->fd);
+#endif
+    }
+
+    // caller holds console_mutex
+    void write(const char* data, size_t len) override {
+        bytes_written += len;
+        append(*streams[0], data, len);
+    }
+
+    // output is waiting behind the writes in progress
+    bool backed_up() const { return has_pending.load() || console_behind.load(); }
+
+    // a mirror needs a keyframe (the render thread presents even if nothing moved)
+    bool keyframe_wanted() const {
+        for (const std::unique_ptr<Stream>& stream : streams)
+            if (stream->wants_keyframe.load()) return true;
+        return false;
+    }
+
+    // --- Present hooks (caller holds screen_mutex) ---
+    // before the console grid is presented: keyframes show what the outputs have
+    // been sent so far, so they go in front of the frame about to be composed
+    void before_present(const ScreenGrid& console) {
+        for (const std::unique_ptr<Stream>& stream : streams) {
+            if (!stream->wants_keyframe.exchange(false)) continue;
+            FrameBuffer& frame = stream->frame;
+            frame.clear();
+            (stream->width ? stream->grid : console).keyframe(frame);
+            std::lock_guard<std::mutex> lock(console_mutex);
+            stream->keyframe.assign(frame.data(), frame.size());
+            stream->keyframe_at = stream->pending.size();
+            stream->keyframe_ready = true;
+            has_pending = true;
+            ready.notify_one();
+        }
+    }
+
+    // after it was presented: the size groups follow it
+    void after_present(const ScreenGrid& console) {
+        for (size_t i = 1; i < streams.size(); ++i) {
+            Stream& stream = *streams[i];
+            if (!stream.width) continue;
+            stream.grid.follow(console);
+            stream.frame.clear();
+            if (!stream.grid.present(stream.frame)) continue;
+            std::lock_guard<std::mutex> lock(console_mutex);
+            append(stream, stream.frame.data(), stream.frame.size());
+        }
+    }
+
+    bool has_mirrors() const { return outputs.size() > 1; }
+    const std::vector<std::unique_ptr<Output>>& all_outputs() const { return outputs; }
+    const std::vector<std::unique_ptr<Stream>>& all_streams() const { return streams; }
+
+    std::atomic<bool> frame_held{ false };     // render thread waits for the console to catch up
+    std::atomic<bool> needs_repaint{ false };  // the console backlog was discarded
+    std::atomic<unsigned long long> overflows{ 0 };
+
+private:
+    // caller holds console_mutex
+    void append(Stream& stream, const char* data, size_t len) {
+        stream.pending.append(data, len);
+        has_pending = true;
+        ready.notify_one();
+    }
+
+    void run() {
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point give_up;
+        std::unique_lock<std::mutex> lock(console_mutex);
+        while (true) {
+            bool behind = false;
+            for (const std::unique_ptr<Output>& output : outputs) behind |= !output->backlog.empty();
+            auto has_work = [this] { return has_pending.load() || stopping; };
+            if (behind) ready.wait_for(lock, std::chrono::milliseconds(OUTPUT_RETRY_MS), has_work);
+            else ready.wait(lock, has_work);
+            if (stopping) {
+                if (give_up == Clock::time_point()) give_up = Clock::now() + std::chrono::milliseconds(STOP_DRAIN_MS);
+                if ((!behind && !has_pending.load()) || Clock::now() >= give_up) break;
+            }
+            for (const std::unique_ptr<Stream>& stream : streams) {
+                stream->writing.swap(stream->pending);
+                stream->keyframe_writing.swap(stream->keyframe);
+                stream->keyframe_writing_at = stream->keyframe_at;
+                stream->keyframe_writing_ready = stream->keyframe_ready;
+                stream->keyframe_ready = false;
+            }
+            has_pending = false;
+            lock.unlock();
+
+            unsigned long long calls = 0;
+            bool wake_renderer = false;
+            for (const std::unique_ptr<Stream>& stream : streams) {
+                for (Output* output : stream->outputs) calls += deliver(*stream, *output, wake_renderer);
+                stream->writing.clear();
+            }
+            if (frame_held.exchange(false) || wake_renderer) wake_marquee_thread();
+
+            lock.lock();
+            syscalls += calls;
+        }
+    }
+
+    // sends the output its backlog and this round's bytes; returns write calls made
+    unsigned long long deliver(Stream& stream, Output& output, bool& wake_renderer) {
+        const char* parts[3];
+        size_t sizes[3];
+        int count = 0;
+        auto add = [&](const char* data, size_t len) {
+            if (len == 0) return;
+            parts[count] = data;
+            sizes[count++] = len;
+        };
+        if (!output.console && output.fd < 0) return 0;
+        if (output.resync) {
+            if (!stream.keyframe_writing_ready) return 0; // still waiting: these bytes are skipped
+            output.resync = false;
+            add(stream.keyframe_writing.data(), stream.keyframe_writing.size());
+            add(stream.writing.data() + stream.keyframe_writing_at, stream.writing.size() - stream.keyframe_writing_at);
+        }
+        else {
+            add(output.backlog.data(), output.backlog.size());
+            add(stream.writing.data(), stream.writing.size());
+        }
+        if (count == 0) return 0;
+
+        unsigned long long calls = 0;
+        size_t sent = send(output, parts, sizes, count, calls);
+        output.sent.fetch_add(sent, std::memory_order_relaxed);
+
+        // keep what it did not take
+        size_t total = 0;
+        for (int i = 0; i < count; ++i) total += sizes[i];
+        if (sent < total) {
+            spare.clear();
+            size_t skip = sent;
+            for (int i = 0; i < count; ++i) {
+                if (skip >= sizes[i]) { skip -= sizes[i]; continue; }
+                spare.append(parts[i] + skip, sizes[i] - skip);
+                skip = 0;
+            }
+            output.backlog.swap(spare);
+        }
+        else {
+            output.backlog.clear();
+        }
+
+        if (output.console) {
+            if (output.backlog.size() > PENDING_CAP) {
+                output.backlog.clear();
+                needs_repaint = true;
+                ++overflows;
+                wake_renderer = true;
+            }
+            console_behind = !output.backlog.empty();
+        }
+        else if (output.backlog.size() > MIRROR_BACKLOG_CAP) {
+            output.backlog.clear();
+            output.resync = true;
+            output.resyncs.fetch_add(1, std::memory_order_relaxed);
+            stream.wants_keyframe = true;
+            wake_renderer = true;
+        }
+        output.behind.store(output.backlog.size(), std::memory_order_relaxed);
+        return calls;
+    }
+
+    // writes as much as the output takes right now; returns the bytes written
+    static size_t send(Output& output, const char* const* parts, const size_t* sizes, int count, unsigned long long& calls) {
+#ifdef _WIN32
+        (void)output;
+        size_t sent = 0;
+        for (int i = 0; i < count; ++i) sent += fwrite(parts[i], 1, sizes[i], stdout);
+        fflush(stdout);
+        ++calls;
+        return sent;
+#else
+        struct iovec iov[3];
+        for (int i = 0; i < count; ++i) {
+            iov[i].iov_base = const_cast<char*>(parts[i]);
+            iov[i].iov_len = sizes[i];
+        }
+        size_t total = 0;
+        for (int i = 0; i < count; ++i) total += sizes[i];
+        size_t sent = 0;
+        int first = 0;
+        while (first < count) {
+            ssize_t n = ::writev(output.fd, iov + first, count - first);
+            ++calls;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                // the output is gone (reader closed, pty hung up): nothing more is kept for it
+                if (!output.console) {
+                    ::close(output.fd);
+                    output.fd = -1;
+                }
+                return total;
+            }
+            sent += static_cast<size_t>(n);
+            size_t left = static_cast<size_t>(n);
+            while (first < count && left >= iov[first].iov_len) left -= iov[first++].iov_len;
+            if (first < count) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+                iov[first].iov_len -= left;
+            }
+        }
+        return sent;
+#endif
+    }
+
+    std::vector<std::unique_ptr<Stream>> streams;   // [0] is the console's
+    std::vector<std::unique_ptr<Output>> outputs;
+    std::string spare;                    // writer thread: rebuilds a backlog
+    std::atomic<bool> has_pending{ false };
+    std::atomic<bool> console_behind{ false };
+    bool stopping = false;                // guarded by console_mutex
+    std::condition_variable ready;
+    std::thread thread;
+#ifndef _WIN32
+    int stdout_flags = 0;
+#endif
+};
+
+// definitions for the constants that are bound by reference (wait_for, milliseconds)
+const size_t WriterSink::PENDING_CAP;
+const size_t WriterSink::MIRROR_BACKLOG_CAP;
+const int WriterSink::OUTPUT_RETRY_MS;
+const int WriterSink::STOP_DRAIN_MS;
+
+WriterSink writer_sink;
+
+// --- Frame recorder (record <file>, --record <file>) ---
+// Part of: Display Implementation
+// Logs what the console showed as timestamped frames, for looking at an
+// incident afterwards (--play). A frame is the diff present() composed, so
+// only the cells that changed; it is cut into chunks at each cursor move, and
+// a chunk seen before is stored as a reference to its first copy. A marquee
+// that keeps cycling draws the same rows over and over, so once every text has
+// gone round once a frame costs a few bytes. Every KEYFRAME_MS a keyframe (the
+// whole screen) lets the player start anywhere. Records are buffered and
+// written out at keyframes (or once OUT_FLUSH_BYTES built up), so a crash
+// loses at most one interval. The dictionary lives in buffers sized once at
+// start, so recording a frame allocates nothing: when it is full, chunks are
+// stored as plain literals and the next frame is a keyframe that resets it.
+//
+// File: "MQREC1\n", then the wall clock at the start (ms since the epoch,
+// 0 for a replay), then records:
+//   'K' <dt> <width> <height> <payload>   keyframe: a clear and the whole screen
+//   'F' <dt> <payload>                    frame: the changes since the last record
+//   'D'                                   dictionary reset: chunk ids start over
+// <dt> is the ms since the previous record. A payload is a chunk count, then
+// per chunk either <length * 2> and the bytes (a new chunk, which gets the next
+// id) or <id * 2 + 1> (a chunk seen before). Numbers are LEB128 varints.
+class FrameRecorder {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const char MAGIC[];
+    static const size_t MAGIC_LEN = 7;
+    static const long long KEYFRAME_MS = 30000;
+    static const size_t DICTIONARY_CAP = 4u << 20;   // chunk bytes kept for matching
+    static const size_t DICTIONARY_SLOTS = 1u << 16; // hash table size; at most half of it is used
+    static const size_t OUT_FLUSH_BYTES = 1u << 20;  // buffered records are written out past this
+
+    ~FrameRecorder() { stop(); }
+
+    bool active() const { return file != nullptr; }
+    const std::string& path() const { return file_path; }
+
+    // the replay's virtual clock instead of steady_clock (nullptr: real time)
+    void use_clock(const Clock::time_point* clock) { virtual_now = clock; }
+
+    // caller holds screen_mutex; the recording starts from what `grid` shows
+    bool start(const std::string& path, const ScreenGrid& grid) {
+        stop();
+        file = fopen(path.c_str(), "wb");
+        if (!file) return false;
+        file_path = path;
+        if (slots.empty()) {
+            slots.resize(DICTIONARY_SLOTS);
+            pool.reserve(DICTIONARY_CAP);
+            out.reserve(2 * OUT_FLUSH_BYTES);
+        }
+        out.assign(MAGIC, MAGIC_LEN);
+        // a keyframe of a full screen must fit even if this one is nearly blank
+        whole.prefault(static_cast<size_t>(grid.width()) * grid.height() * 16);
+        long long wall_ms = virtual_now ? 0 : std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        put_varint(static_cast<unsigned long long>(wall_ms));
+        started = now();
+        last_ms = 0;
+        reset_dictionary();
+        keyframe(grid, 0);
+        return true;
+    }
+
+    void stop() {
+        if (!file) return;
+        flush();
+        fclose(file);
+        file = nullptr;
+    }
+
+    // caller holds screen_mutex; `bytes` is what present() just composed and
+    // `grid` shows the result
+    void frame(const char* bytes, size_t len, const ScreenGrid& grid) {
+        long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(now() - started).count();
+        if (full || ms - keyframe_ms >= KEYFRAME_MS) {
+            keyframe(grid, ms); // the same screen, seekable
+            return;
+        }
+        out.push_back('F');
+        put_time(ms);
+        put_payload(bytes, len);
+        if (out.size() >= OUT_FLUSH_BYTES) flush();
+    }
+
+private:
+    Clock::time_point now() const { return virtual_now ? *virtual_now : Clock::now(); }
+
+    void keyframe(const ScreenGrid& grid, long long ms) {
+        if (full) {
+            out.push_back('D');
+            reset_dictionary();
+        }
+        whole.clear();
+        grid.keyframe(whole);
+        out.push_back('K');
+        put_time(ms);
+        put_varint(static_cast<unsigned long long>(grid.width()));
+        put_varint(static_cast<unsigned long long>(grid.height()));
+        put_payload(whole.data(), whole.size());
+        keyframe_ms = ms;
+        flush();
+    }
+
+    void flush() {
+        if (!out.empty()) fwrite(out.data(), 1, out.size(), file);
+        fflush(file);
+        out.clear();
+    }
+
+    void reset_dictionary() {
+        std::fill(slots.begin(), slots.end(), Slot());
+        entries = 0;
+        next_id = 0;
+        pool.clear();
+        full = false;
+    }
+
+    void put_varint(unsigned long long value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void put_time(long long ms) {
+        put_varint(static_cast<unsigned long long>((std::max)(ms - last_ms, 0LL)));
+        last_ms = (std::max)(ms, last_ms);
+    }
+
+    // chunks start at each cursor move (ESC [ row ; col H)
+    static bool cursor_move_at(const char* bytes, size_t len, size_t i) {
+        if (i + 2 >= len || bytes[i] != '\033' || bytes[i + 1] != '[') return false;
+        for (size_t j = i + 2; j < len; ++j) {
+            if (bytes[j] == 'H') return true;
+            if (bytes[j] != ';' && !isdigit(static_cast<unsigned char>(bytes[j]))) return false;
+        }
+        return false;
+    }
+
+    void put_payload(const char* bytes, size_t len) {
+        cuts.clear();
+        cuts.push_back(0);
+        for (size_t i = 1; i < len; ++i)
+            if (cursor_move_at(bytes, len, i)) cuts.push_back(i);
+        cuts.push_back(len);
+        put_varint(cuts.size() - 1);
+        for (size_t c = 0; c + 1 < cuts.size(); ++c) {
+            const char* chunk = bytes + cuts[c];
+            size_t size = cuts[c + 1] - cuts[c];
+            unsigned long long hash = 14695981039346656037ull; // FNV-1a
+            for (size_t i = 0; i < size; ++i) hash = (hash ^ static_cast<unsigned char>(chunk[i])) * 1099511628211ull;
+            // linear probing; the table is never more than half full, so an empty slot ends the search
+            size_t at = static_cast<size_t>(hash) & (DICTIONARY_SLOTS - 1);
+            while (slots[at].id != 0 && slots[at].hash != hash) at = (at + 1) & (DICTIONARY_SLOTS - 1);
+            Slot& slot = slots[at];
+            if (slot.id != 0 && slot.length == size && memcmp(pool.data() + slot.offset, chunk, size) == 0) {
+                put_varint(static_cast<unsigned long long>(slot.id - 1) * 2 + 1);
+                continue;
+            }
+            // a new chunk: every literal takes the next id, as the player numbers them;
+            // it can be matched later if its hash is new and the dictionary has room
+            unsigned id = next_id++;
+            if (slot.id == 0) {
+                if (entries < DICTIONARY_SLOTS / 2 && pool.size() + size <= DICTIONARY_CAP) {
+                    slot.hash = hash;
+                    slot.offset = pool.size();
+                    slot.length = size;
+                    slot.id = id + 1;
+                    ++entries;
+                    pool.append(chunk, size);
+                }
+                else {
+                    full = true;
+                }
+            }
+            put_varint(static_cast<unsigned long long>(size) * 2);
+            out.append(chunk, size);
+        }
+    }
+
+    FILE* file = nullptr;
+    std::string file_path;
+    const Clock::time_point* virtual_now = nullptr;
+    Clock::time_point started;
+    long long last_ms = 0;                 // time of the last record
+    long long keyframe_ms = 0;             // time of the last keyframe
+    std::string out;                       // encoded records not yet written
+    FrameBuffer whole;                     // keyframe scratch
+    std::vector<size_t> cuts;              // chunk boundaries of the payload being encoded
+
+    struct Slot {
+        unsigned long long hash = 0;
+        size_t offset = 0;                 // chunk bytes in pool
+        size_t length = 0;
+        unsigned id = 0;                   // chunk id + 1 (0: empty slot)
+    };
+    std::vector<Slot> slots;               // chunk hash -> first chunk with that hash
+    size_t entries = 0;                    // used slots
+    unsigned next_id = 0;                  // id of the next literal chunk
+    bool full = false;                     // a chunk did not fit: reset at the next frame
+    std::string pool;                      // matchable chunks since the last dictionary reset
+};
+
+const char FrameRecorder::MAGIC[] = "MQREC1\n";
+
+FrameRecorder recorder;   // guarded by screen_mutex
+
+// --- Screen state ---
+// Lock order: see Shared state (the render thread only try_locks screen_mutex)
+ScreenGrid screen;
+std::mutex screen_mutex;
+
+// --- Present the back grid to the console, every mirror and the recording ---
+// Part of: Display Implementation
+// caller holds screen_mutex
+bool present_grid(FrameBuffer& frame) {
+    const size_t start = frame.size();
+    bool changed;
+    if (!writer_sink.has_mirrors()) {
+        changed = screen.present(frame);
+    }
+    else {
+        writer_sink.before_present(screen);
+        changed = screen.present(frame);
+        writer_sink.after_present(screen);
+    }
+    if (changed && recorder.active()) recorder.frame(frame.data() + start, frame.size() - start, screen);
+    return changed;
+}
+
+// --- Present the back grid, keeping the user's cursor where it was ---
+// Part of: Display Implementation
+// caller holds screen_mutex so frames reach the terminal in diff order; returns bytes written
+size_t present_screen() {
+    FrameBuffer& frame = ui_frame;
+    frame.save_cursor();
+    if (!present_grid(frame)) {
+        frame.clear();
+        return 0;
+    }
+    frame.restore_cursor();
+    size_t bytes = frame.size();
+    flush_frame(frame);
+    return bytes;
+}
+
+// --- Help area rows (between status and prompt) ---
+// caller holds layout_mutex and screen_mutex
+void clear_help_area() {
+    for (int row = layout.help_row + 8; row <= layout.prompt_row; ++row) {
+        screen.clear_row(row);
+    }
+}
+
+// rows taken by the names of help_entries[first..] when listed without descriptions
+int help_name_rows(int first, int width) {
+    int rows = 0;
+    int col = 1;
+    for (int i = first; i < help_entry_count; ++i) {
+        int len = static_cast<int>(strcspn(help_entries[i].name + 2, " ")) + 2;
+        if (col == 1 || col + len > width + 1) {
+            col = 1;
+            ++rows;
+        }
+        col += len;
+    }
+    return rows;
+}
+
+// --- Draw help list into the back grid ---
+// caller holds layout_mutex and screen_mutex
+void draw_help_line() {
+    clear_help_area();
+
+    // print help starting at adjusted HELP_ROW (row help_row + 8 stays blank)
+    int row = layout.help_row + 9;
+    screen.put(1, row, "Available Commands:", Attrs::BOLD | Attrs::BRIGHT_CYAN);
+
+    // one command per row while they fit; when the prompt would be pushed off
+    // screen, the last ones are listed by name only, wrapped into the rows left
+    int rows_left = layout.prompt_row - row;
+    int described = help_entry_count;
+    while (described > 0 && described + help_name_rows(described, layout.screen_width) > rows_left) --described;
+    for (int i = 0; i < described; ++i) {
+        const HelpEntry& entry = help_entries[i];
+        ++row;
+        Attr name_attr = entry.terminates ? Attrs::BRIGHT_RED : Attrs::BRIGHT_YELLOW;
+        int col = screen.put(1, row, entry.name, strlen(entry.name), name_attr);
+        screen.put(col, row, entry.description, strlen(entry.description), Attrs::WHITE);
+    }
+    int col = 1;
+    for (int i = described; i < help_entry_count; ++i) {
+        const HelpEntry& entry = help_entries[i];
+        size_t len = strcspn(entry.name + 2, " ") + 2;  // "  name" without its arguments
+        if (col == 1 || col + static_cast<int>(len) > layout.screen_width + 1) {
+            col = 1;
+            ++row;
+        }
+        if (row > layout.prompt_row) break;
+        col = screen.put(col, row, entry.name, len, entry.terminates ? Attrs::BRIGHT_RED : Attrs::BRIGHT_YELLOW);
+    }
+}
+
+// --- Draw help tip into the back grid ---
+// caller holds layout_mutex and screen_mutex
+void draw_help_tip() {
+    clear_help_area();
+    screen.put(1, layout.help_row + 9, "Type 'help' for available commands.", Attrs::BRIGHT_GREEN);
+}
+
+// --- Draw one marquee lane window into the back grid ---
+// Part of: Marquee Animation Logic
+// caller holds screen_mutex; no allocations. `fields` (the render thread's
+// latest field values) are drawn over the strip where they are in view.
+void draw_lane_window(const MarqueeText& content, MarqueeStyle style, int slot, long long position, const ConsoleLayout& view,
+                      const FieldValue* fields = nullptr) {
+    if (slot >= view.marquee_rows) return;
+    int row = view.marquee_text_row + 8 + slot;
+    const Attr* gradient = style == STYLE_GRADIENT && !view.gradient.empty() ? view.gradient.data() : nullptr;
+    if (content.feed) {
+        // as much of the window as has been read; the rest stays blank
+        int width = (std::min)(view.marquee_width, StreamFeed::MAX_WINDOW);
+        unsigned long long column = static_cast<unsigned long long>(position);
+        unsigned long long produced = content.feed->produced();
+        int shown = produced > column ? static_cast<int>((std::min)(produced - column, static_cast<unsigned long long>(width))) : 0;
+        const Attr* attrs = style == STYLE_RAINBOW ? rainbow_run.attr + column % RAINBOW_PERIOD : gradient;
+        if (shown > 0) screen.put_glyphs(2, row, content.feed->window(column), shown, Attrs::WHITE, attrs);
+        screen.fill(2 + shown, row, width - shown, ' ', Attrs::WHITE);
+        return;
+    }
+    const MarqueeStrip& strip = content.strip;
+    if (strip.cycle == 0) return;
+    int pos = position < strip.cycle ? static_cast<int>(position) : 0;
+    int width = (std::min)(strip.width, view.marquee_width);
+    const Attr* attrs = gradient ? gradient : (content.attrs.empty() ? nullptr : content.attrs.data() + pos);
+    screen.put_glyphs(2, row, strip.window(pos), width, Attrs::WHITE, attrs);
+    // banner font rows that fit in the box, each the same window of its own strip
+    int rows = (std::min)(content.rows(), view.marquee_rows - slot);
+    for (int r = 1; r < rows; ++r)
+        screen.put_glyphs(2, row + r, content.lower_rows[r - 1].window(pos), width, Attrs::WHITE, attrs);
+    if (!fields) return;
+    for_visible_fields(content, pos, width, [&](size_t index, int start) {
+        int field_width = content.fields[index].width;
+        int first = (std::max)(start, pos);
+        int end = (std::min)(start + field_width, pos + width);
+        if (first >= end) return;
+        const Attr* field_attrs = gradient ? gradient + (first - pos) : (content.attrs.empty() ? nullptr : content.attrs.data() + first);
+        const Glyph* glyphs = fields[index].glyphs.data() + (first - start);
+        for (int r = 0; r < rows; ++r)
+            screen.put_glyphs(2 + first - pos, row + r, glyphs + r * field_width, end - first, Attrs::WHITE, field_attrs);
+    });
+}
+
+// --- Draw status line into the back grid ---
+// caller holds layout_mutex and screen_mutex
+void draw_status_line() {
+    int row = layout.status_row + 8;
+    screen.clear_row(row);
+    SnapshotCell<MarqueeSet>::Read lanes = marquee_set.read();
+    const MarqueeConfig* lane = lanes->find(current_lane.load());
+    if (!lane) return;
+
+    int col = screen.put(1, row, "Status: ", Attrs::BRIGHT_WHITE);
+    if (lane->running)
+        col = screen.put(col, row, "Running", Attrs::BRIGHT_GREEN);
+    else
+        col = screen.put(col, row, "Stopped", Attrs::RED);
+    col = screen.put(col, row, " | Speed: ", Attrs::BRIGHT_WHITE);
+    char text[48];
+    int n = snprintf(text, sizeof(text), "%dms", lane->speed);
+    col = screen.put(col, row, text, static_cast<size_t>(n), Attrs::YELLOW);
+    if (lanes->lanes.size() > 1) {
+        col = screen.put(col, row, " | Lane: ", Attrs::BRIGHT_WHITE);
+        n = snprintf(text, sizeof(text), "%d of %d", lane->id, static_cast<int>(lanes->lanes.size()));
+        screen.put(col, row, text, static_cast<size_t>(n), Attrs::YELLOW);
+    }
+}
+
+// --- Draw prompt into the back grid ---
+// caller holds prompt_mutex, layout_mutex and screen_mutex
+void draw_prompt() {
+    int row = layout.prompt_row + 2;
+    // the terminal echoed the typed line here (and possibly wrapped onto the next row)
+    screen.invalidate_row(row);
+    screen.invalidate_row(row + 1);
+    screen.clear_row(row);
+    screen.put(layout.prompt_col, row, prompt_display, Attrs::CYAN);
+}
+
+// The show_* helpers and update_status_line are called by commands. They only
+// draw into the back grid; the command batch presents everything its commands
+// drew at once when it finishes (see CommandBatch).
+
+// --- Displays help line ---
+// Part of: Display Implementation
+void show_help_line() {
+    CountedLock lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    draw_help_line();
+}
+
+// --- Clears the help area and shows the help tip ---
+// Part of: Display Implementation
+void show_help_tip() {
+    CountedLock lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    draw_help_tip();
+}
+
+// achieved scroll steps per second of a lane since it was started or its speed changed
+double achieved_step_rate(const MarqueeConfig& lane, long long now_ns) {
+    const LaneStats& stats = lane_stats[lane.id];
+    double elapsed = (now_ns - stats.timing_since_ns.load(std::memory_order_relaxed)) / 1e9;
+    return (lane.running && elapsed > 0.0) ? stats.steps.load(std::memory_order_relaxed) / elapsed : 0.0;
+}
+
+long long steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// --- Shows per-lane animation timing in the help area ---
+// Part of: Display Implementation
+void show_timing() {
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    clear_help_area();
+    SnapshotCell<MarqueeSet>::Read lanes = marquee_set.read();
+
+    int row = layout.help_row + 9;
+    char header[96];
+    int header_len = snprintf(header, sizeof(header), "Lane timing (achieved vs configured steps/s, render cap %d fps):",
+        lanes->fps_cap);
+    screen.put(1, row, header, static_cast<size_t>(header_len), Attrs::BOLD | Attrs::BRIGHT_CYAN);
+    long long now_ns = steady_now_ns();
+    for (const MarqueeConfig& lane : lanes->lanes) {
+        if (++row >= layout.prompt_row + 1) break;
+        const LaneStats& stats = lane_stats[lane.id];
+        char text[160];
+        int n = snprintf(text, sizeof(text), "  Lane %d: %s %.2f / %.2f | late %llu | dropped %llu",
+            lane.id, lane.running ? "running" : "stopped", achieved_step_rate(lane, now_ns), 1000.0 / lane.speed,
+            stats.frames_late.load(std::memory_order_relaxed), stats.frames_dropped.load(std::memory_order_relaxed));
+        screen.put(1, row, text, static_cast<size_t>(n), Attrs::WHITE);
+    }
+}
+
+// --- Counter totals across every thread ---
+// Part of: Display Implementation
+struct HistogramSummary {
+    unsigned long long count = 0;
+    unsigned long long total_ns = 0;
+    unsigned long long max_ns = 0;
+    unsigned long long p50_ns = 0;
+    unsigned long long p99_ns = 0;
+};
+
+struct CounterTotals {
+    HistogramSummary frame_time, jitter, console_wait, layout_wait, command_latency;
+    unsigned long long frame_bytes = 0;
+    unsigned long long frames_held = 0;
+    unsigned long long queue_depth = 0;
+    unsigned long long queue_depth_max = 0;
+};
+
+HistogramSummary summarize(LatencyHistogram ThreadCounters::* which) {
+    unsigned long long buckets[LatencyHistogram::BUCKETS] = {};
+    HistogramSummary summary;
+    int threads = (std::min)(counter_threads.load(), MAX_COUNTER_THREADS);
+    for (int t = 0; t < threads; ++t) {
+        const LatencyHistogram& h = thread_counters[t].*which;
+        for (int i = 0; i < LatencyHistogram::BUCKETS; ++i) buckets[i] += h.buckets[i].load(std::memory_order_relaxed);
+        summary.count += h.count.load(std::memory_order_relaxed);
+        summary.total_ns += h.total_ns.load(std::memory_order_relaxed);
+        summary.max_ns = (std::max)(summary.max_ns, h.max_ns.load(std::memory_order_relaxed));
+    }
+
+    // percentiles are the upper edge of the bucket they fall in (never above the max)
+    unsigned long long seen = 0;
+    unsigned long long p50_rank = (summary.count + 1) / 2;
+    unsigned long long p99_rank = summary.count - summary.count / 100;
+    for (int i = 0; i < LatencyHistogram::BUCKETS && seen < p99_rank; ++i) {
+        if (buckets[i] == 0) continue;
+        bool below_p50 = seen < p50_rank;
+        seen += buckets[i];
+        unsigned long long limit = (std::min)(LatencyHistogram::bucket_limit(i), summary.max_ns);
+        if (below_p50 && seen >= p50_rank) summary.p50_ns = limit;
+        if (seen >= p99_rank) summary.p99_ns = limit;
+    }
+    return summary;
+}
+
+CounterTotals collect_counters() {
+    CounterTotals totals;
+    totals.frame_time = summarize(&ThreadCounters::frame_time);
+    totals.jitter = summarize(&ThreadCounters::jitter);
+    totals.console_wait = summarize(&ThreadCounters::console_wait);
+    totals.layout_wait = summarize(&ThreadCounters::layout_wait);
+    totals.command_latency = summarize(&ThreadCounters::command_latency);
+    int threads = (std::min)(counter_threads.load(), MAX_COUNTER_THREADS);
+    for (int t = 0; t < threads; ++t) {
+        const ThreadCounters& c = thread_counters[t];
+        totals.frame_bytes += c.frame_bytes.load(std::memory_order_relaxed);
+        totals.frames_held += c.frames_held.load(std::memory_order_relaxed);
+        totals.queue_depth += c.queue_depth.load(std::memory_order_relaxed);
+        totals.queue_depth_max = (std::max)(totals.queue_depth_max, c.queue_depth_max.load(std::memory_order_relaxed));
+    }
+    return totals;
+}
+
+// --- Write the counters as JSON ---
+// Part of: Display Implementation
+void write_histogram_json(FILE* out, const char* name, const HistogramSummary& h, bool last) {
+    fprintf(out, "  \"%s\": { \"count\": %llu, \"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, \"total_ms\": %.3f }%s\n",
+        name, h.count, h.p50_ns / 1e3, h.p99_ns / 1e3, h.max_ns / 1e3, h.total_ns / 1e6, last ? "" : ",");
+}
+
+std::string json_escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+    }
+    return escaped;
+}
+
+bool dump_stats_json(const std::string& path) {
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out) return false;
+
+    CounterTotals totals = collect_counters();
+    SnapshotCell<MarqueeSet>::Read lanes = marquee_set.read();
+    long long now_ns = steady_now_ns();
+    unsigned long long frames = totals.frame_time.count;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"uptime_s\": %.3f,\n", elapsed_ns(process_start) / 1e9);
+    fprintf(out, "  \"fps_cap\": %d,\n", lanes->fps_cap);
+    fprintf(out, "  \"frames\": %llu,\n", frames);
+    fprintf(out, "  \"bytes_per_frame\": %.1f,\n", frames ? static_cast<double>(totals.frame_bytes) / frames : 0.0);
+    fprintf(out, "  \"frames_dropped_output_behind\": %llu,\n", totals.frames_held);
+    fprintf(out, "  \"output_overflows\": %llu,\n", writer_sink.overflows.load());
+    fprintf(out, "  \"outputs\": [\n");
+    const std::vector<std::unique_ptr<WriterSink::Output>>& outputs = writer_sink.all_outputs();
+    for (size_t i = 0; i < outputs.size(); ++i) {
+        const WriterSink::Output& output = *outputs[i];
+        fprintf(out, "    { \"path\": \"%s\", \"bytes\": %llu, \"backlog\": %llu, \"resyncs\": %llu }%s\n",
+            json_escape(output.path).c_str(), output.sent.load(), output.behind.load(), output.resyncs.load(),
+            i + 1 < outputs.size() ? "," : "");
+    }
+    fprintf(out, "  ],\n");
+    write_histogram_json(out, "frame_time", totals.frame_time, false);
+    write_histogram_json(out, "jitter", totals.jitter, false);
+    write_histogram_json(out, "console_mutex_wait", totals.console_wait, false);
+    write_histogram_json(out, "layout_mutex_wait", totals.layout_wait, false);
+    write_histogram_json(out, "command_latency", totals.command_latency, false);
+    fprintf(out, "  \"command_queue_depth\": %llu,\n", totals.queue_depth);
+    fprintf(out, "  \"command_queue_depth_max\": %llu,\n", totals.queue_depth_max);
+    fprintf(out, "  \"lanes\": [\n");
+    for (size_t i = 0; i < lanes->lanes.size(); ++i) {
+        const MarqueeConfig& lane = lanes->lanes[i];
+        const LaneStats& stats = lane_stats[lane.id];
+        fprintf(out, "    { \"id\": %d, \"running\": %s, \"configured_steps_per_s\": %.3f, \"achieved_steps_per_s\": %.3f, "
+            "\"late\": %llu, \"dropped\": %llu }%s\n",
+            lane.id, lane.running ? "true" : "false", 1000.0 / lane.speed, achieved_step_rate(lane, now_ns),
+            stats.frames_late.load(std::memory_order_relaxed), stats.frames_dropped.load(std::memory_order_relaxed),
+            i + 1 < lanes->lanes.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
+
+// --- Shows live performance counters in the help area ---
+// Part of: Display Implementation
+void show_stats(const std::string& json_path) {
+    bool dumped = !json_path.empty() && dump_stats_json(json_path);
+    CounterTotals totals = collect_counters();
+
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    clear_help_area();
+    SnapshotCell<MarqueeSet>::Read lanes = marquee_set.read();
+
+    int row = layout.help_row + 9;
+    int last_row = layout.prompt_row;
+    char text[256];
+    auto line = [&](Attr attr, const char* format, ...) {
+        if (row > last_row) return;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+        n = (std::max)(0, (std::min)(n, static_cast<int>(sizeof(text)) - 1));
+        screen.put(1, row++, text, static_cast<size_t>(n), attr);
+    };
+    auto us = [](unsigned long long ns) { return ns / 1e3; };
+
+    unsigned long long frames = totals.frame_time.count;
+    line(Attrs::BOLD | Attrs::BRIGHT_CYAN, "Performance counters (%.1fs uptime, render cap %d fps):",
+        elapsed_ns(process_start) / 1e9, lanes->fps_cap);
+    line(Attrs::WHITE, "  Frames: %llu | render p50 %.1fus p99 %.1fus max %.1fus",
+        frames, us(totals.frame_time.p50_ns), us(totals.frame_time.p99_ns), us(totals.frame_time.max_ns));
+    line(Attrs::WHITE, "  Jitter: p50 %.1fus p99 %.1fus max %.1fus",
+        us(totals.jitter.p50_ns), us(totals.jitter.p99_ns), us(totals.jitter.max_ns));
+    line(Attrs::WHITE, "  Bytes per frame: %.1f | dropped while terminal behind: %llu (backlog discarded %llu times)",
+        frames ? static_cast<double>(totals.frame_bytes) / frames : 0.0, totals.frames_held, writer_sink.overflows.load());
+    line(Attrs::WHITE, "  console_mutex wait: p99 %.1fus max %.1fus total %.3fms",
+        us(totals.console_wait.p99_ns), us(totals.console_wait.max_ns), totals.console_wait.total_ns / 1e6);
+    line(Attrs::WHITE, "  layout_mutex wait: p99 %.1fus max %.1fus total %.3fms",
+        us(totals.layout_wait.p99_ns), us(totals.layout_wait.max_ns), totals.layout_wait.total_ns / 1e6);
+    line(Attrs::WHITE, "  Commands: %llu | queue depth %llu (max %llu) | latency p50 %.1fus p99 %.1fus",
+        totals.command_latency.count, totals.queue_depth, totals.queue_depth_max,
+        us(totals.command_latency.p50_ns), us(totals.command_latency.p99_ns));
+
+    // achieved / configured steps per second, as many lanes as fit on one row
+    long long now_ns = steady_now_ns();
+    int width = (std::min)(static_cast<int>(sizeof(text)) - 1, layout.screen_width);
+    int n = snprintf(text, sizeof(text), "  Tick rate (achieved/configured):");
+    for (const MarqueeConfig& lane : lanes->lanes) {
+        char entry[48];
+        int len = snprintf(entry, sizeof(entry), " %d: %.1f/%.1f", lane.id, achieved_step_rate(lane, now_ns), 1000.0 / lane.speed);
+        if (n + len > width) break;
+        memcpy(text + n, entry, static_cast<size_t>(len));
+        n += len;
+    }
+    if (row <= last_row) screen.put(1, row++, text, static_cast<size_t>(n), Attrs::WHITE);
+
+    // one row per mirror (console first)
+    if (writer_sink.has_mirrors()) {
+        for (const std::unique_ptr<WriterSink::Output>& output : writer_sink.all_outputs())
+            line(Attrs::WHITE, "  Output %.60s: %.1fKB sent | backlog %lluB | resyncs %llu", output->path.c_str(),
+                output->sent.load() / 1024.0, output->behind.load(), output->resyncs.load());
+    }
+
+    if (!json_path.empty() && row <= last_row) {
+        int col = screen.put(1, row, dumped ? "  Counters written to " : "  Could not write counters to ",
+            dumped ? Attrs::BRIGHT_GREEN : Attrs::RED);
+        screen.put(col, row, json_path, dumped ? Attrs::BRIGHT_GREEN : Attrs::RED);
+    }
+}
+
+// --- Shows the frame jitter histogram in the help area ---
+// Part of: Display Implementation
+// Jitter is how late each frame started after its lane's deadline. The bins
+// are powers of two so each one is made of whole LatencyHistogram buckets.
+void show_jitter() {
+    const int first_edge = 13;    // 2^13 ns = 8.2us
+    const int bins = 11;          // the last one is open-ended (from 2^22 ns = 4.2ms)
+    const int bar_width = 40;
+    unsigned long long counts[bins] = {};
+    unsigned long long total = 0;
+    int threads = (std::min)(counter_threads.load(), MAX_COUNTER_THREADS);
+    for (int t = 0; t < threads; ++t) {
+        const LatencyHistogram& h = thread_counters[t].jitter;
+        for (int i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+            unsigned long long n = h.buckets[i].load(std::memory_order_relaxed);
+            if (n == 0) continue;
+            int bin = 0;
+            while (bin < bins - 1 && LatencyHistogram::bucket_limit(i) >= (1ULL << (first_edge + bin))) ++bin;
+            counts[bin] += n;
+            total += n;
+        }
+    }
+    HistogramSummary summary = summarize(&ThreadCounters::jitter);
+
+    char mode[256];
+    if (!low_jitter.enabled) {
+        snprintf(mode, sizeof(mode), "  Low-jitter mode: off (start with --low-jitter <cpu> [--realtime])");
+    }
+    else if (!low_jitter.applied.load(std::memory_order_acquire)) {
+        snprintf(mode, sizeof(mode), "  Low-jitter mode: starting");
+    }
+    else {
+        char realtime[64];
+        if (!low_jitter.realtime) snprintf(realtime, sizeof(realtime), "SCHED_OTHER");
+        else if (low_jitter.realtime_error) snprintf(realtime, sizeof(realtime), "SCHED_FIFO refused (%s)", strerror(low_jitter.realtime_error));
+        else snprintf(realtime, sizeof(realtime), "SCHED_FIFO %d", LOW_JITTER_RT_PRIORITY);
+        char pinned[48];
+        if (low_jitter.pin_error) snprintf(pinned, sizeof(pinned), "not pinned (%s)", strerror(low_jitter.pin_error));
+        else snprintf(pinned, sizeof(pinned), "CPU %d", low_jitter.cpu);
+        char locked[48];
+        if (low_jitter.lock_error) snprintf(locked, sizeof(locked), "memory not locked (%s)", strerror(low_jitter.lock_error));
+        else snprintf(locked, sizeof(locked), "memory locked");
+        snprintf(mode, sizeof(mode), "  Low-jitter mode: %s | %s | %s | spin %dus", pinned, realtime, locked, LOW_JITTER_SPIN_US);
+    }
+
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    clear_help_area();
+    int row = layout.help_row + 9;
+    int last_row = layout.prompt_row;
+    char text[160];
+    int n = snprintf(text, sizeof(text), "Frame jitter (%llu frames | p50 %.1fus p99 %.1fus max %.1fus):",
+        total, summary.p50_ns / 1e3, summary.p99_ns / 1e3, summary.max_ns / 1e3);
+    screen.put(1, row++, text, static_cast<size_t>(n), Attrs::BOLD | Attrs::BRIGHT_CYAN);
+    screen.put(1, row++, mode, Attrs::WHITE);
+
+    // a short help area (small window, tall marquee box) folds the slowest bins into the open-ended one
+    int shown = (std::max)(1, (std::min)(bins, last_row - row + 1));
+    for (int bin = shown; bin < bins; ++bin) counts[shown - 1] += counts[bin];
+    unsigned long long tallest = *std::max_element(counts, counts + shown);
+    for (int bin = 0; bin < shown && row <= last_row; ++bin, ++row) {
+        double low_us = bin == 0 ? 0.0 : (1ULL << (first_edge + bin - 1)) / 1e3;
+        double high_us = (1ULL << (first_edge + bin)) / 1e3;
+        if (bin < shown - 1)
+            n = snprintf(text, sizeof(text), "  %6.0f - %6.0fus ", low_us, high_us);
+        else
+            n = snprintf(text, sizeof(text), "  %6.0fus and more ", low_us);
+        int col = screen.put(1, row, text, static_cast<size_t>(n), Attrs::WHITE);
+        int bar = tallest ? static_cast<int>((counts[bin] * bar_width + tallest - 1) / tallest) : 0;
+        screen.fill(col, row, bar, '#', bin == 0 ? Attrs::BRIGHT_GREEN : (bin < 5 ? Attrs::YELLOW : Attrs::RED));
+        n = snprintf(text, sizeof(text), " %llu (%.1f%%)", counts[bin], total ? 100.0 * counts[bin] / total : 0.0);
+        screen.put(col + bar, row, text, static_cast<size_t>(n), Attrs::WHITE);
+    }
+}
+
+// --- Shows an error message (e.g. unknown command) above the help area ---
+// Part of: Display Implementation
+void show_error_line(const std::string& prefix, const std::string& detail) {
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    int row = layout.help_row + 7;
+    screen.clear_row(row);
+    int col = screen.put(1, row, prefix, Attrs::RED);
+    screen.put(col, row, detail, Attrs::RED);
+}
+
+// --- Show a confirmation above the help tip ---
+void show_info_line(const std::string& prefix, const std::string& detail) {
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    int row = layout.help_row + 7;
+    screen.clear_row(row);
+    int col = screen.put(1, row, prefix, Attrs::BRIGHT_GREEN);
+    screen.put(col, row, detail, Attrs::BRIGHT_WHITE);
+}
+
+// --- Draw the title, developer info and version date into the back grid ---
+// caller holds layout_mutex and screen_mutex
+void draw_header() {
+    // title (row 1)
+    screen.put(1, 1, "========= Welcome to CSOPESY Marquee Console =========", Attrs::BOLD | Attrs::BRIGHT_BLUE);
+
+    // developer info (rows 3-6)
+    screen.put(1, 3, "Group Developer: Alvarez, Ivan Antonio T.", Attrs::BRIGHT_CYAN);
+    screen.put(1, 4, "                 Barlaan, Bahir Benjamin C.", Attrs::BRIGHT_CYAN);
+    screen.put(1, 5, "                 Co, Joshua Benedict B.", Attrs::BRIGHT_CYAN);
+    screen.put(1, 6, "                 Tan, Reyvin Matthew T.", Attrs::BRIGHT_CYAN);
+
+    // version date (row 8)
+    screen.put(1, 8, "Version date: October 1, 2025", Attrs::BRIGHT_YELLOW);
+}
+
+// --- Draw the marquee box and every lane into the back grid ---
+// caller holds layout_mutex and screen_mutex
+void draw_marquee_box() {
+    // marquee box (shifted down by 2 rows)
+    int right = layout.marquee_width + 2;
+    screen.put(1, layout.marquee_top_row + 8, "+", Attrs::MAGENTA);
+    screen.fill(2, layout.marquee_top_row + 8, layout.marquee_width, '-', Attrs::MAGENTA);
+    screen.put(right, layout.marquee_top_row + 8, "+", Attrs::MAGENTA);
+    for (int slot = 0; slot < layout.marquee_rows; ++slot) {
+        screen.put(1, layout.marquee_text_row + 8 + slot, "|", Attrs::MAGENTA);
+        screen.put(right, layout.marquee_text_row + 8 + slot, "|", Attrs::MAGENTA);
+    }
+    screen.put(1, layout.marquee_bottom_row + 8, "+", Attrs::MAGENTA);
+    screen.fill(2, layout.marquee_bottom_row + 8, layout.marquee_width, '-', Attrs::MAGENTA);
+    screen.put(right, layout.marquee_bottom_row + 8, "+", Attrs::MAGENTA);
+
+    // lanes keep their current scroll position across redraws
+    SnapshotCell<MarqueeSet>::Read lanes = marquee_set.read();
+    for (const MarqueeConfig& lane : lanes->lanes)
+        draw_lane_window(*lane.content, lane.style, lane.slot, lane_stats[lane.id].position.load(std::memory_order_relaxed), layout);
+}
+
+// --- Draw the status line and the help tip or list into the back grid ---
+// caller holds layout_mutex and screen_mutex
+void draw_status_and_help() {
+    // status (shifted down by 2 rows)
+    draw_status_line();
+
+    // help tip or help list (shifted down by 2 rows)
+    if (help_visible.load())
+        draw_help_line();
+    else
+        draw_help_tip();
+}
+
+// --- Draw the static UI once (title, marquee box, initial status/help, prompt) ---
+// Part of: Display Implementation
+void display_static_ui() {
+    update_layout(); // updates the layout based on current console size
+
+    std::lock_guard<std::mutex> prompt_lock(prompt_mutex);
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+
+    // the terminal content is unknown (first draw or lost output), start from a cleared screen
+    if (screen.width() != layout.screen_width || screen.height() != layout.screen_height)
+        screen.resize(layout.screen_width, layout.screen_height);
+    screen.invalidate_all();
+    screen.clear();
+
+    draw_header();
+    draw_marquee_box();
+    draw_status_and_help();
+
+    // prompt (shifted down by 2 rows)
+    draw_prompt();
+
+    FrameBuffer& frame = ui_frame;
+    present_grid(frame);
+    frame.move_to(layout.prompt_col + static_cast<int>(prompt_display.size()), layout.prompt_row + 2);
+    flush_frame(frame);
+}
+
+// --- Reflow the UI after a resize ---
+// Part of: Display Implementation
+// Recomputes the layout and redraws only the regions whose geometry changed.
+// The terminal keeps what is still inside the new size, so everything else,
+// the line being typed at the prompt included, stays as it is; the renderer
+// keeps each lane's scroll phase (see MarqueeRenderer::apply). Anything the
+// terminal may have cut off, rewrapped or scrolled falls back to a full redraw.
+void reflow_ui() {
+    ConsoleLayout before;
+    {
+        CountedLock lock(layout_mutex, &ThreadCounters::layout_wait);
+        before = layout;
+    }
+    update_layout();
+
+    std::lock_guard<std::mutex> prompt_lock(prompt_mutex);
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    FrameBuffer& frame = ui_frame;
+    if (!screen.keeps_content(layout.screen_width, layout.screen_height)) {
+        screen.resize(layout.screen_width, layout.screen_height);
+        screen.invalidate_all();
+        screen.clear();
+        draw_header();
+        draw_marquee_box();
+        draw_status_and_help();
+        draw_prompt();
+        present_grid(frame);
+        frame.move_to(layout.prompt_col + static_cast<int>(prompt_display.size()), layout.prompt_row + 2);
+        flush_frame(frame);
+        return;
+    }
+    screen.reshape(layout.screen_width, layout.screen_height);
+
+    // the box follows the width and the lane rows; status, help and prompt sit below it
+    bool box_changed = layout.marquee_width != before.marquee_width || layout.marquee_rows != before.marquee_rows;
+    bool rows_moved = layout.status_row != before.status_row;
+    bool wider = layout.screen_width > before.screen_width;
+    if (box_changed) {
+        for (int row = before.marquee_top_row + 8; row <= before.marquee_bottom_row + 8; ++row) screen.clear_row(row);
+    }
+    if (rows_moved) {
+        for (int row = before.status_row + 8; row <= before.prompt_row + 3; ++row) screen.clear_row(row);
+    }
+    // text the old width cut off can show now; only the uncovered columns differ
+    if (wider) draw_header();
+    if (box_changed || rows_moved) draw_marquee_box();
+    if (rows_moved || wider) draw_status_and_help();
+
+    if (!rows_moved) {
+        present_screen(); // the cursor stays in the input being typed
+        return;
+    }
+    draw_prompt();
+    present_grid(frame);
+    frame.move_to(layout.prompt_col + static_cast<int>(prompt_display.size()), layout.prompt_row + 2);
+    flush_frame(frame);
+}
+
+// --- Update status line ---
+// Part of: Display Implementation
+void update_status_line() {
+    CountedLock lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    draw_status_line();
+}
+
+// --- Marquee renderer: lane runtime state owned by the render thread ---
+// Part of: Marquee Animation Logic
+// Commands only publish a new MarqueeSet; the renderer notices the new version,
+// applies what changed to its own lanes and reschedules them. Nothing here is
+// shared with other threads except the LaneStats counters it publishes.
+class MarqueeRenderer {
+public:
+    typedef MarqueeScheduler::Clock Clock;
+
+    // applies the latest published configuration (cheap when nothing changed)
+    void sync(Clock::time_point now) {
+        SnapshotCell<MarqueeSet>::Read set = marquee_set.read();
+        if (set->version == applied_version) return;
+        applied_version = set->version;
+        scheduler.set_frame_cap(set->fps_cap);
+        for (const MarqueeConfig& config : set->lanes)
+            apply(lanes[config.id], config, now);
+    }
+
+    bool idle() const { return scheduler.empty(); }
+    Clock::time_point next_deadline() const { return scheduler.next_deadline(); }
+
+    // --- Advance every lane that is due and draw it into the back grid ---
+    // caller holds screen_mutex; returns true if anything was drawn
+    // Deadlines are absolute steady_clock times at which a lane's window next
+    // moves; where the text is comes from elapsed time, not from how many frames
+    // were drawn. A frame that comes late (or is held back by the frame cap) jumps
+    // straight to the current position, and the positions it passed over are
+    // counted as dropped frames. Lanes whose window did not move are not redrawn.
+    bool advance_due(Clock::time_point now, const ConsoleLayout& view) {
+        int lane_id = 0;
+        unsigned generation = 0;
+        Clock::time_point deadline;
+        const Clock::time_point frame_start = scheduler.frame_start();
+        bool drawn = false;
+        while (scheduler.pop_due(now, lane_id, generation, deadline)) {
+            auto it = lanes.find(lane_id);
+            if (it == lanes.end()) continue;
+            Marquee& lane = it->second;
+            if (!lane.running || lane.generation != generation) continue; // stale tick
+            if (lane.content->feed) {
+                drawn |= advance_stream(lane, now, deadline, frame_start, view);
+                scheduler.schedule(lane, lane.next_step_after(now));
+                continue;
+            }
+            if (lane.cycle() == 0) continue;
+
+            int position = lane.position_at(now);
+            bool refreshed = !lane.fields.empty() && refresh_fields(lane, now, position, view);
+            if (position != lane.position || lane.dirty || refreshed) {
+                LaneStats& stats = lane_stats[lane.id];
+                int advanced = static_cast<int>((position - lane.position + lane.cycle()) % lane.cycle());
+                if (advanced > 1) stats.frames_dropped.fetch_add(static_cast<unsigned long long>(advanced - 1), std::memory_order_relaxed);
+                if (now - (std::max)(deadline, frame_start) > LATE_TOLERANCE) stats.frames_late.fetch_add(1, std::memory_order_relaxed);
+                stats.steps.fetch_add(static_cast<unsigned long long>(advanced), std::memory_order_relaxed);
+                stats.position.store(position, std::memory_order_relaxed);
+                lane.position = position;
+                lane.dirty = false;
+                draw_lane_window(*lane.content, lane.style, lane.slot, lane.position, view, lane.fields.data());
+                drawn = true;
+            }
+            // a visible field may be due before the window moves again
+            scheduler.schedule(lane, (std::min)(lane.next_step_after(now), lane.fields_due));
+        }
+        if (drawn) scheduler.frame_rendered(now);
+        return drawn;
+    }
+
+private:
+    // Re-evaluates the fields in the window at `position` whose refresh
+    // interval has passed and notes when the next visible one is due; returns
+    // true when a value changed. Fields out of view are not even looked at.
+    bool refresh_fields(Marquee& lane, Clock::time_point now, int position, const ConsoleLayout& view) {
+        const MarqueeText& content = *lane.content;
+        int width = (std::min)(content.strip.width, view.marquee_width);
+        int rows = content.rows();
+        bool changed = false;
+        lane.fields_due = Clock::time_point::max();
+        for_visible_fields(content, position, width, [&](size_t index, int) {
+            const TextField& field = content.fields[index];
+            FieldValue& value = lane.fields[index];
+            if (now >= value.next_refresh) {
+                char text[FIELD_VALUE_BYTES];
+                size_t len = field_value(field, text, sizeof(text));
+                layout_field(text, len, field.width, rows, field_scratch.data());
+                if (!std::equal(value.glyphs.begin(), value.glyphs.end(), field_scratch.begin())) {
+                    std::copy(field_scratch.begin(), field_scratch.begin() + value.glyphs.size(), value.glyphs.begin());
+                    changed = true;
+                }
+                value.next_refresh = now + field.refresh;
+            }
+            lane.fields_due = (std::min)(lane.fields_due, value.next_refresh);
+        });
+        return changed;
+    }
+
+    // field values start as the strip shows them (the value the text was set with)
+    void reset_fields(Marquee& lane, Clock::time_point now) {
+        const MarqueeText& content = *lane.content;
+        lane.fields.resize(content.fields.size());
+        lane.fields_due = Clock::time_point::max();
+        for (size_t i = 0; i < content.fields.size(); ++i) {
+            const TextField& field = content.fields[i];
+            FieldValue& value = lane.fields[i];
+            value.next_refresh = now;
+            value.glyphs.clear();
+            for (int r = 0; r < content.rows(); ++r) {
+                const MarqueeStrip& strip = r == 0 ? content.strip : content.lower_rows[r - 1];
+                value.glyphs.insert(value.glyphs.end(), strip.columns.begin() + field.column,
+                    strip.columns.begin() + field.column + field.width);
+            }
+            if (field_scratch.size() < value.glyphs.size()) field_scratch.resize(value.glyphs.size());
+        }
+    }
+
+    // A streamed lane scrolls by absolute column. When it catches up with the
+    // data it waits at the end (the phase is held there), and a partly filled
+    // window is redrawn as more of it arrives.
+    bool advance_stream(Marquee& lane, Clock::time_point now, Clock::time_point deadline,
+        Clock::time_point frame_start, const ConsoleLayout& view) {
+        StreamFeed& feed = *lane.content->feed;
+        int width = (std::min)(view.marquee_width, StreamFeed::MAX_WINDOW);
+        unsigned long long produced = feed.produced();
+        long long last = produced > static_cast<unsigned long long>(width) ? static_cast<long long>(produced) - width : 0;
+        long long column = static_cast<long long>(std::floor(lane.scroll_at(now)));
+        if (column > last) {
+            column = (std::max)(last, lane.position);
+            lane.phase = static_cast<double>(column);
+            lane.phase_origin = now;
+        }
+        unsigned long long shown_end = (std::min)(produced, static_cast<unsigned long long>(column) + width);
+        if (column == lane.position && shown_end == lane.shown_end && !lane.dirty) return false;
+
+        LaneStats& stats = lane_stats[lane.id];
+        long long advanced = column - lane.position;
+        if (advanced > 1) stats.frames_dropped.fetch_add(static_cast<unsigned long long>(advanced - 1), std::memory_order_relaxed);
+        if (advanced > 0 && now - (std::max)(deadline, frame_start) > LATE_TOLERANCE) stats.frames_late.fetch_add(1, std::memory_order_relaxed);
+        if (advanced > 0) stats.steps.fetch_add(static_cast<unsigned long long>(advanced), std::memory_order_relaxed);
+        feed.consume(static_cast<unsigned long long>(column));
+        stats.position.store(column, std::memory_order_relaxed);
+        lane.position = column;
+        lane.shown_end = shown_end;
+        lane.dirty = false;
+        draw_lane_window(*lane.content, lane.style, lane.slot, lane.position, view);
+        return true;
+    }
+
+    void apply(Marquee& lane, const MarqueeConfig& config, Clock::time_point now) {
+        LaneStats& stats = lane_stats[config.id];
+        bool restart = false;
+        Clock::time_point restart_at = now;
+        lane.id = config.id;
+        if (lane.slot != config.slot) {
+            lane.slot = config.slot;
+            lane.dirty = true;
+        }
+
+        if (lane.content != config.content) {
+            bool new_text = !lane.content || lane.content->version != config.content->version;
+            // same text rewrapped for a new width: fold the phase into the old cycle first
+            if (!new_text && lane.running && lane.cycle() > 0 && !lane.content->feed) lane.rebase(now);
+            lane.content = config.content;
+            reset_fields(lane, now);
+            if (new_text) {
+                // new text starts scrolling from the beginning
+                lane.position = 0;
+                lane.shown_end = 0;
+                lane.phase = 0.0;
+                lane.phase_origin = now;
+            }
+            else if (lane.cycle() > 0 && !lane.content->feed) {
+                // width changed, same text: the text stays where it is on screen (against
+                // the left edge while it scrolls out, the right edge while it comes back in)
+                long long last = lane.cycle() - 1;
+                lane.position = (std::min)(lane.position, last);
+                lane.phase = (std::min)(lane.phase, static_cast<double>(last));
+            }
+            stats.position.store(lane.position, std::memory_order_relaxed);
+            lane.dirty = true;
+            restart = lane.running;
+        }
+
+        if (lane.style != config.style) {
+            // gradient and stream rainbow colors are picked at draw time
+            lane.style = config.style;
+            lane.dirty = true;
+            restart = lane.running;
+        }
+
+        if (lane.speed != config.speed) {
+            if (lane.running) {
+                // keep the current scroll phase; only the velocity changes from here on
+                lane.rebase(now);
+                lane.speed = config.speed;
+                reset_stats(stats, now);
+                restart = true;
+                restart_at = lane.next_step_after(now);
+            }
+            else {
+                lane.speed = config.speed;
+            }
+        }
+
+        if (lane.running != config.running) {
+            lane.running = config.running;
+            ++lane.generation;
+            restart = false;
+            if (lane.running) {
+                // resume from the window that is on screen
+                lane.phase = static_cast<double>(lane.position);
+                lane.phase_origin = now;
+                lane.dirty = true;
+                reset_stats(stats, now);
+                scheduler.schedule(lane, now);
+            }
+        }
+
+        if (restart) {
+            ++lane.generation;
+            scheduler.schedule(lane, lane.dirty ? now : restart_at);
+        }
+    }
+
+    static void reset_stats(LaneStats& stats, Clock::time_point now) {
+        stats.timing_since_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count(),
+            std::memory_order_relaxed);
+        stats.steps.store(0, std::memory_order_relaxed);
+        stats.frames_late.store(0, std::memory_order_relaxed);
+        stats.frames_dropped.store(0, std::memory_order_relaxed);
+    }
+
+    std::map<int, Marquee> lanes;
+    MarqueeScheduler scheduler;
+    unsigned long long applied_version = 0;
+    std::vector<Glyph> field_scratch;   // a field's new value, compared with the one shown
+};
+
+MarqueeRenderer marquee_renderer;      // used only by the marquee thread
+
+// --- Sleep until a deadline or until a command publishes a change ---
+// Part of: Marquee Animation Logic
+void wait_for_marquee_change(bool until_deadline, MarqueeScheduler::Clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(marquee_wake_mutex);
+    auto woken = [] { return marquee_wake_pending || !is_running.load(); };
+    if (until_deadline)
+        marquee_cv.wait_until(lock, deadline, woken);
+    else
+        marquee_cv.wait(lock, woken);
+    marquee_wake_pending = false;
+}
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// --- Wait for the next lane deadline ---
+// Part of: Marquee Animation Logic
+// A sleeping thread wakes up late by the scheduler's wakeup latency, and that
+// latency is what other workloads on the host make worse. In low-jitter mode
+// the thread sleeps until LOW_JITTER_SPIN_US before the deadline, then spins
+// the rest of the way on its own CPU. Returns early when woken by a command.
+void wait_for_deadline(MarqueeScheduler::Clock::time_point deadline) {
+    typedef MarqueeScheduler::Clock Clock;
+    if (!low_jitter.enabled) {
+        wait_for_marquee_change(true, deadline);
+        return;
+    }
+    Clock::time_point spin_from = deadline - std::chrono::microseconds(LOW_JITTER_SPIN_US);
+    if (Clock::now() < spin_from) {
+        wait_for_marquee_change(true, spin_from);
+        return; // the caller looks again and spins from here
+    }
+    while (Clock::now() < deadline) cpu_relax();
+}
+
+#ifdef __linux__
+// --- Low-jitter setup of the marquee thread (runs on it) ---
+// Part of: Marquee Animation Logic
+// Pins the thread to the chosen CPU, asks for SCHED_FIFO if --realtime was
+// given and cuts the timer slack, so sleeps end when asked. Then it faults in
+// the stack and the frame buffer the frame path uses and locks the memory.
+// Each step that is refused (no privileges, RLIMIT_MEMLOCK) is recorded and
+// the rest carries on without it.
+void enter_low_jitter_mode() {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(low_jitter.cpu, &cpus);
+    low_jitter.pin_error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (low_jitter.realtime) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = LOW_JITTER_RT_PRIORITY;
+        low_jitter.realtime_error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+    // the frame path runs below this frame on the stack; a frame is at most a few bytes per cell
+    volatile char stack[LOW_JITTER_STACK_BYTES];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) stack[i] = 0;
+    {
+        SnapshotCell<ConsoleLayout>::Read view = layout_view.read();
+        ui_frame.prefault(static_cast<size_t>(view->screen_width) * view->screen_height * 16);
+    }
+
+    // what is mapped now is locked as it is faulted in. Not MCL_FUTURE: under a
+    // finite RLIMIT_MEMLOCK later thread stacks or heap growth would fail instead
+    // of just going unlocked, and the frame path allocates nothing (--alloc-probe).
+#ifdef MCL_ONFAULT
+    int flags = MCL_CURRENT | MCL_ONFAULT;
+#else
+    int flags = MCL_CURRENT;
+#endif
+    low_jitter.lock_error = mlockall(flags) == 0 ? 0 : errno;
+    low_jitter.applied.store(true, std::memory_order_release);
+}
+#endif
+
+// --- Marquee thread: drives every lane from one deadline heap ---
+// Part of: Marquee Animation Logic
+// Reads lanes and layout only through snapshots. The one lock on the frame path
+// is the screen, and it is only tried: while a command is drawing, the frame is
+// retried shortly instead of waiting behind it. While the writer is behind, due
+// frames are drawn into the back grid but not presented (see WriterSink); the
+// writer wakes this thread when it catches up and the newest frame goes out.
+void marquee_thread_func() {
+    typedef MarqueeScheduler::Clock Clock;
+    MarqueeRenderer& renderer = marquee_renderer;
+    bool held = false;   // the back grid has a frame that was not presented yet
+#ifdef __linux__
+    if (low_jitter.enabled) enter_low_jitter_mode();
+#endif
+    while (is_running) {
+        renderer.sync(Clock::now());
+        bool repaint = writer_sink.needs_repaint.load() || writer_sink.keyframe_wanted();
+        Clock::time_point deadline = renderer.idle() ? Clock::now() : renderer.next_deadline();
+        if (held || repaint) {
+            // due frames are still drawn (and counted as dropped) until the writer wakes us
+            writer_sink.frame_held = true;
+            if (writer_sink.backed_up() && (renderer.idle() || Clock::now() < deadline)) {
+                wait_for_marquee_change(!renderer.idle(), deadline);
+                continue;
+            }
+        }
+        else if (renderer.idle()) {
+            wait_for_marquee_change(false, Clock::time_point()); // nothing running: sleep until a lane starts
+            continue;
+        }
+        else if (Clock::now() < deadline) {
+            wait_for_deadline(deadline);
+            continue;
+        }
+        std::unique_lock<std::mutex> screen_lock(screen_mutex, std::try_to_lock);
+        if (!screen_lock.owns_lock()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+            continue;
+        }
+        SnapshotCell<ConsoleLayout>::Read view = layout_view.read();
+        Clock::time_point start = Clock::now();
+        bool drew = renderer.advance_due(start, *view);
+        if (!drew && !held && !repaint) continue;
+        ThreadCounters& counters = my_counters();
+        if (writer_sink.backed_up()) {
+            // the terminal is behind: this frame is replaced by a newer one
+            if (drew) counters.frames_held.fetch_add(1, std::memory_order_relaxed);
+            held = true;
+            continue;
+        }
+        if (writer_sink.needs_repaint.exchange(false)) screen.invalidate_all();
+        held = false;
+        size_t bytes = present_screen();
+        if (drew) {
+            counters.jitter.record(std::chrono::duration_cast<std::chrono::nanoseconds>(start - deadline).count());
+            counters.frame_time.record(elapsed_ns(start));
+            counters.frame_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+}
+
+// --- Create a lane on first use ---
+// Part of: Marquee Animation Logic
+// returns true when the lane is new (the box layout changed and needs a redraw)
+bool ensure_marquee_lane(int id) {
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> state_lock(marquee_state_mutex);
+    std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+    if (lanes->find(id)) return false;
+
+    MarqueeConfig lane;
+    lane.id = id;
+    lane.content = make_marquee_text(DEFAULT_MARQUEE_TEXT, layout.marquee_width, 0, lane.style, lane.keywords, lane.font);
+    auto at = std::lower_bound(lanes->lanes.begin(), lanes->lanes.end(), id,
+        [](const MarqueeConfig& entry, int key) { return entry.id < key; });
+    lanes->lanes.insert(at, lane);
+    assign_slots(*lanes);
+    marquee_set.publish(std::move(lanes));
+    wake_marquee_thread();
+    return true;
+}
+
+// --- Start / stop a lane ---
+// Part of: Marquee Animation Logic
+void set_marquee_running(int id, bool running) {
+    {
+        std::lock_guard<std::mutex> lock(marquee_state_mutex);
+        std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+        MarqueeConfig* lane = lanes->find(id);
+        if (!lane) return;
+        current_lane = id;
+        if (lane->running != running) {
+            lane->running = running;
+            marquee_set.publish(std::move(lanes));
+        }
+    }
+    wake_marquee_thread();
+}
+
+// --- Set marquee text ---
+// Part of: Marquee Animation Logic
+void set_marquee_text(int id, const std::string& text) {
+    file_fields().prefetch(text); // before the locks: a file may be slow to read
+    {
+        CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+        std::lock_guard<std::mutex> lock(marquee_state_mutex);
+        std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+        MarqueeConfig* lane = lanes->find(id);
+        if (!lane) return;
+        current_lane = id;
+        lane->content = make_marquee_text(text.empty() ? " " : text, layout.marquee_width, lane->content->version + 1,
+                                          lane->style, lane->keywords, lane->font);
+        if (assign_slots(*lanes)) layout_redraw_pending = true;
+        marquee_set.publish(std::move(lanes));
+        prune_file_fields();
+    }
+    wake_marquee_thread();
+}
+
+// --- Stream a lane's text from a file, FIFO or growing log ---
+// Part of: Marquee Animation Logic
+// returns false when the source cannot be opened (the lane keeps its text)
+bool set_marquee_source(int id, const std::string& path, bool follow) {
+    // opened before the locks: opening a file on a slow mount (or a named pipe
+    // on Windows) can block, and the padding is corrected under the lock below
+    std::shared_ptr<StreamFeed> feed = StreamFeed::open(path, follow, layout_view.read()->marquee_width);
+    if (!feed) return false;
+    {
+        CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+        std::lock_guard<std::mutex> lock(marquee_state_mutex);
+        std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+        MarqueeConfig* lane = lanes->find(id);
+        if (!lane) {
+            feed->stop(); // its thread ends and drops the last reference
+            return false;
+        }
+        feed->set_padding(layout.marquee_width);
+        current_lane = id;
+        std::shared_ptr<MarqueeText> content = std::make_shared<MarqueeText>();
+        content->text = path;
+        content->feed = feed;
+        content->version = lane->content->version + 1;
+        lane->content = content;
+        if (assign_slots(*lanes)) layout_redraw_pending = true; // a banner lane shrinks to one row
+        marquee_set.publish(std::move(lanes));
+        prune_file_fields();
+    }
+    wake_marquee_thread();
+    return true;
+}
+
+// --- Set the color style of a lane ---
+// Part of: Marquee Animation Logic
+// A text lane gets its colors laid out again under the same version, so it
+// keeps scrolling from where it is.
+void set_marquee_style(int id, MarqueeStyle style, const std::vector<std::string>& keywords) {
+    {
+        CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+        std::lock_guard<std::mutex> lock(marquee_state_mutex);
+        std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+        MarqueeConfig* lane = lanes->find(id);
+        if (!lane) return;
+        current_lane = id;
+        lane->style = style;
+        lane->keywords = keywords;
+        if (!lane->content->feed)
+            lane->content = make_marquee_text(lane->content->text, layout.marquee_width, lane->content->version, style, keywords, lane->font);
+        marquee_set.publish(std::move(lanes));
+    }
+    wake_marquee_thread();
+}
+
+// --- Set the font of a lane ---
+// Part of: Marquee Animation Logic
+// A text lane is rendered again in the new font and starts over from the
+// beginning; the box grows or shrinks with it. A streamed lane keeps its one
+// row and uses the font once it is given a fixed text.
+void set_marquee_font(int id, MarqueeFont font) {
+    {
+        CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+        std::lock_guard<std::mutex> lock(marquee_state_mutex);
+        std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+        MarqueeConfig* lane = lanes->find(id);
+        if (!lane) return;
+        current_lane = id;
+        if (lane->font == font) return;
+        lane->font = font;
+        if (!lane->content->feed)
+            lane->content = make_marquee_text(lane->content->text, layout.marquee_width, lane->content->version + 1,
+                                              lane->style, lane->keywords, font);
+        if (assign_slots(*lanes)) layout_redraw_pending = true;
+        marquee_set.publish(std::move(lanes));
+    }
+    wake_marquee_thread();
+}
+
+// --- Set marquee speed ---
+// Part of: Marquee Animation Logic
+void set_marquee_speed(int id, int spd) {
+    {
+        std::lock_guard<std::mutex> lock(marquee_state_mutex);
+        std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+        MarqueeConfig* lane = lanes->find(id);
+        if (!lane) return;
+        current_lane = id;
+        if (spd > 0 && spd != lane->speed) {
+            lane->speed = spd;
+            marquee_set.publish(std::move(lanes));
+        }
+    }
+    wake_marquee_thread();
+}
+
+// --- Set the render frame cap (frames per second, all lanes together) ---
+// Part of: Marquee Animation Logic
+void set_render_fps(int fps) {
+    {
+        std::lock_guard<std::mutex> lock(marquee_state_mutex);
+        std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+        lanes->fps_cap = (std::max)(1, (std::min)(fps, MAX_FPS_CAP));
+        marquee_set.publish(std::move(lanes));
+    }
+    wake_marquee_thread();
+}
+
+// --- Apply the coalesced control socket updates (command thread) ---
+// Part of: Marquee Animation Logic
+void apply_control_updates() {
+    ControlUpdates updates;
+    {
+        std::lock_guard<std::mutex> lock(control_updates_mutex);
+        std::swap(updates, control_updates);
+        control_updates_queued = false;
+    }
+    for (const auto& entry : updates.text) layout_redraw_pending |= ensure_marquee_lane(entry.first);
+    for (const auto& entry : updates.speed) layout_redraw_pending |= ensure_marquee_lane(entry.first);
+
+    for (const auto& entry : updates.text) set_marquee_text(entry.first, entry.second);
+    for (const auto& entry : updates.speed) set_marquee_speed(entry.first, entry.second);
+    update_status_line();
+}
+
+// --- Check if console size changed and redraw if needed ---
+void check_and_handle_resize() {
+    int current_width, current_height;
+    get_console_size(current_width, current_height);
+
+    bool size_changed = false;
+    {
+        CountedLock lock(layout_mutex, &ThreadCounters::layout_wait);
+        if (current_width != layout.screen_width || current_height != layout.screen_height) {
+            size_changed = true;
+        }
+    }
+
+    if (size_changed) {
+        reflow_ui(); // updates the layout and redraws what moved
+    }
+}
+
+#ifdef _WIN32
+// --- Background resize monitoring thread ---
+// (Windows consoles have no resize signal, so the size is polled)
+void resize_monitor_thread_func() {
+    while (is_running) {
+        check_and_handle_resize();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // check every 100ms
+    }
+}
+
+void install_resize_signal() {}
+void wake_resize_monitor() {}
+#else
+// --- Resize notifications: SIGWINCH -> self-pipe -> resize thread ---
+// The handler only writes one byte (async-signal-safe); the thread sleeps in
+// poll() with no timeout, so there are no wakeups while the size is unchanged.
+const int RESIZE_SETTLE_MS = 16;   // a burst of resize signals is handled once it goes quiet
+const int RESIZE_FOLLOW_MS = 100;  // ...or this long after it started, so a long drag is followed
+int resize_pipe[2] = { -1, -1 };
+
+void on_sigwinch(int) {
+    int saved_errno = errno;
+    char byte = 'r';
+    ssize_t ignored = write(resize_pipe[1], &byte, 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+void install_resize_signal() {
+    if (pipe(resize_pipe) != 0) return;
+    for (int fd : resize_pipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigwinch;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART; // keep std::getline in the keyboard thread from failing with EINTR
+    sigaction(SIGWINCH, &sa, nullptr);
+}
+
+// lets the resize thread notice is_running == false
+void wake_resize_monitor() {
+    if (resize_pipe[1] < 0) return;
+    char byte = 'q';
+    ssize_t ignored = write(resize_pipe[1], &byte, 1);
+    (void)ignored;
+}
+
+void drain_resize_pipe() {
+    char bytes[64];
+    while (read(resize_pipe[0], bytes, sizeof(bytes)) > 0) {}
+}
+
+// --- Background resize thread: blocks until SIGWINCH, debounces, redraws once ---
+void resize_monitor_thread_func() {
+    if (resize_pipe[0] < 0) return;
+    struct pollfd pfd;
+    pfd.fd = resize_pipe[0];
+    pfd.events = POLLIN;
+    while (is_running) {
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) <= 0) continue;
+        drain_resize_pipe();
+        if (!is_running) break;
+
+        // dragging a window edge sends a burst of signals; wait until it settles
+        std::chrono::steady_clock::time_point follow_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(RESIZE_FOLLOW_MS);
+        while (is_running) {
+            long long left = std::chrono::duration_cast<std::chrono::milliseconds>(follow_at - std::chrono::steady_clock::now()).count();
+            if (left <= 0 || poll(&pfd, 1, static_cast<int>((std::min)(left, static_cast<long long>(RESIZE_SETTLE_MS)))) <= 0) break;
+            drain_resize_pipe();
+        }
+        if (!is_running) break;
+        check_and_handle_resize();
+    }
+}
+#endif
+
+// --- Input line splitting ---
+// Part of: Command Recognition
+// sanitize input
+void trim_command(std::string& s) {
+    s.erase(0, s.find_first_not_of(" \t\r\n"));
+    if (!s.empty()) s.erase(s.find_last_not_of(" \t\r\n") + 1);
+}
+
+// collects raw input bytes and hands out complete, trimmed, non-empty lines
+class LineReader {
+public:
+    template <typename F>
+    void feed(const char* data, size_t len, F on_line) {
+        for (size_t i = 0; i < len; ++i) {
+            if (data[i] == '\n') emit(on_line);
+            else pending.push_back(data[i]);
+        }
+    }
+
+    // end of input: a last line without a newline still counts
+    template <typename F>
+    void finish(F on_line) {
+        if (!pending.empty()) emit(on_line);
+    }
+
+    size_t buffered() const { return pending.size(); }
+
+private:
+    template <typename F>
+    void emit(F& on_line) {
+        trim_command(pending);
+        if (!pending.empty()) on_line(pending);
+        pending.clear();
+    }
+
+    std::string pending;
+};
+
+// --- Command arguments ---
+// Part of: Command Recognition
+enum CommandFlags {
+    TAKES_LANE = 1,       // an optional lane id comes first
+    TAKES_VALUE = 2,      // the rest of the line is the command's value
+    NUMERIC_VALUE = 4,    // a lone number is the value, not the lane id
+    TEXT_VALUE = 8        // free text: a number in front is a lane id only if that lane exists
+};
+
+struct CommandArgs {
+    int lane = DEFAULT_LANE;
+    std::string lane_word;   // the lane id as typed (for the error message)
+    std::string value;       // rest of the line, trimmed
+};
+
+struct CommandSpec {
+    const char* name;
+    unsigned flags;
+    bool (*run)(const CommandArgs& args);   // returns false to end the session
+};
+
+const CommandSpec* find_command(const std::string& name);
+
+// splits "<command> [lane id] [value]"; returns false for an invalid lane id
+bool parse_command_args(const CommandSpec& spec, const std::string& line, CommandArgs& args) {
+    std::string rest = line.substr((std::min)(strlen(spec.name), line.size()));
+    trim_command(rest);
+    if (spec.flags & TAKES_LANE) {
+        size_t end = rest.find_first_of(" \t");
+        std::string word = rest.substr(0, end);
+        bool marked = word.size() > 1 && word[0] == '#';   // "#2" is always a lane id
+        std::string digits = marked ? word.substr(1) : word;
+        bool numeric = !digits.empty() && digits.find_first_not_of("0123456789") == std::string::npos;
+        int id = numeric && digits.size() <= 3 ? atoi(digits.c_str()) : 0;
+        bool more = end != std::string::npos;
+        // before a value only a number is a lane id; a lone number is the value
+        // itself when the value is numeric ("set_speed 50"), and text may start
+        // with a number ("set_text 2024 recap") unless it names an existing lane
+        bool is_lane;
+        if (marked && numeric)
+            is_lane = true;
+        else if (!(spec.flags & TAKES_VALUE))
+            is_lane = !word.empty();
+        else if (spec.flags & NUMERIC_VALUE)
+            is_lane = numeric && more;
+        else if (spec.flags & TEXT_VALUE)
+            is_lane = numeric && more && marquee_set.read()->find(id) != nullptr;
+        else
+            is_lane = numeric;
+        if (is_lane) {
+            args.lane_word = word;
+            args.lane = id;
+            if (args.lane < 1 || args.lane > MAX_LANE_ID) return false;
+            rest.erase(0, word.size());
+            trim_command(rest);
+        }
+    }
+    if (spec.flags & TAKES_VALUE) args.value = rest;
+    return true;
+}
+
+// the leading number of text if it is positive, else 0
+int parse_positive(const std::string& text) {
+    try {
+        int value = std::stoi(text);
+        return value > 0 ? value : 0;
+    }
+    catch (...) {
+        return 0;
+    }
+}
+
+void queue_command(const std::string& line, CommandOrigin origin) {
+    {
+        std::lock_guard<std::mutex> lock(command_queue_mutex);
+        command_queue.push(QueuedCommand{ line, std::chrono::steady_clock::now(), origin });
+    }
+    command_queue_cv.notify_one();
+#ifndef _WIN32
+    if (command_event_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(command_event_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+#endif
+}
+
+void push_command(const std::string& line) {
+    queue_command(line, FROM_KEYBOARD);
+}
+
+// queues every line of one read at once, so a paste reaches the command thread as one batch
+void push_commands(std::vector<std::string>& lines) {
+    if (lines.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(command_queue_mutex);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (std::string& line : lines) command_queue.push(QueuedCommand{ std::move(line), now, FROM_KEYBOARD });
+    }
+    lines.clear();
+    command_queue_cv.notify_one();
+}
+
+#ifdef _WIN32
+void install_input_wake() {}
+void wake_keyboard_thread() {}
+#else
+// --- Keyboard wakeup: lets the keyboard thread stop without another line of input ---
+int input_wake_pipe[2] = { -1, -1 };
+
+void install_input_wake() {
+    if (pipe(input_wake_pipe) != 0) return;
+    for (int fd : input_wake_pipe) fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+void wake_keyboard_thread() {
+    if (input_wake_pipe[1] < 0) return;
+    char byte = 'q';
+    ssize_t ignored = write(input_wake_pipe[1], &byte, 1);
+    (void)ignored;
+}
+#endif
+
+// --- Keyboard Handler ---
+// Part of: Command Recognition
+// On POSIX stdin is read with poll() next to a wakeup pipe, so exit does not
+// have to wait for one more line of input before the thread can be joined.
+void keyboard_handler_thread_func() {
+#ifdef _WIN32
+    std::string line;
+    while (is_running) {
+        if (!std::getline(std::cin, line)) { // EOF or error
             is_running = false;
+            command_queue_cv.notify_all();
+            break;
+        }
+
+        trim_command(line);
+        if (line.empty()) continue;
+        push_command(line);
+    }
+#else
+    LineReader reader;
+    std::vector<std::string> lines;
+    auto collect = [&lines](const std::string& line) { lines.push_back(line); };
+    char buffer[4096];
+    struct pollfd fds[2];
+    fds[0].fd = STDIN_FILENO;
+    fds[0].events = POLLIN;
+    fds[1].fd = input_wake_pipe[0];
+    fds[1].events = POLLIN;
+    while (is_running) {
+        fds[0].revents = fds[1].revents = 0;
+        if (poll(fds, input_wake_pipe[0] >= 0 ? 2 : 1, -1) < 0) continue;
+        if (fds[1].revents) break; // shutting down
+        if (!fds[0].revents) continue;
+
+        ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) { // EOF or error
+            reader.finish(collect);
+            push_commands(lines);
+            is_running = false;
+            command_queue_cv.notify_all();
             break;
         }
+        reader.feed(buffer, static_cast<size_t>(n), collect);
+        push_commands(lines);
+    }
+#endif
+}
+
+#ifndef _WIN32
+// --- Control socket (--control <path>) ---
+// Part of: Command Recognition
+// Other processes drive the console through a Unix domain socket, one command
+// per line with the prompt's syntax; set_text and set_speed must carry their
+// value since there is no prompt to answer. Every line is answered with "ok"
+// or "error: <reason>" (dropped if the client does not read them).
+// set_text/set_speed are coalesced: only the latest value per lane is kept,
+// and the batch reaches the command thread at most once per frame, so a burst
+// of updates costs one configuration change per frame. Other commands are
+// queued as they arrive. The socket is the owner's alone (mode 0600 from the
+// moment it exists): a client can run any command, record <file> included.
+class ControlServer {
+public:
+    static const int MAX_CLIENTS = 256;
+    static const size_t MAX_LINE = 64 * 1024;
+
+    bool start(const char* socket_path) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (strlen(socket_path) >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        strcpy(address.sun_path, socket_path);
+
+        // a socket left behind by an earlier run is replaced; any other file is not
+        struct stat info;
+        if (lstat(socket_path, &info) == 0 && S_ISSOCK(info.st_mode)) unlink(socket_path);
+
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) return false;
+        set_nonblocking(listen_fd);
+        // created 0600 (the umask is process-wide, but no other thread runs yet),
+        // so no other user can connect before it is locked down
+        mode_t previous_umask = umask(0177);
+        bool bound = bind(listen_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+        umask(previous_umask);
+        if (bound && (lstat(socket_path, &info) != 0 || (info.st_mode & 0077) != 0)) {
+            unlink(socket_path); // not the owner's alone: refuse rather than listen open to others
+            bound = false;
+            errno = EPERM;
+        }
+        if (!bound || listen(listen_fd, SOMAXCONN) != 0 || pipe(wake_pipe) != 0) {
+            int saved_errno = errno;
+            ::close(listen_fd);
+            listen_fd = -1;
+            errno = saved_errno;
+            return false;
+        }
+        path = socket_path;
+        for (int fd : wake_pipe) fcntl(fd, F_SETFD, FD_CLOEXEC);
+        thread = std::thread(&ControlServer::run, this);
+        return true;
+    }
+
+    void stop() {
+        if (listen_fd < 0) return;
+        char byte = 'q';
+        ssize_t ignored = write(wake_pipe[1], &byte, 1);
+        (void)ignored;
+        if (thread.joinable()) thread.join();
+        for (Client& client : clients) ::close(client.fd);
+        clients.clear();
+        ::close(listen_fd);
+        ::close(wake_pipe[0]);
+        ::close(wake_pipe[1]);
+        listen_fd = -1;
+        unlink(path.c_str());
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Client {
+        int fd;
+        LineReader reader;
+    };
+
+    static void set_nonblocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    static void reply(int fd, const std::string& text) {
+        std::string message = text + "\n";
+        ssize_t ignored = send(fd, message.data(), message.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        (void)ignored;
+    }
+
+    static Clock::duration frame_interval() {
+        SnapshotCell<MarqueeSet>::Read lanes = marquee_set.read();
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / (std::max)(1, lanes->fps_cap);
+    }
+
+    void run() {
+        std::vector<struct pollfd> fds;
+        char buffer[64 * 1024];
+        Clock::time_point last_flush;
+        while (is_running) {
+            fds.clear();
+            fds.push_back(pollfd{ wake_pipe[0], POLLIN, 0 });
+            fds.push_back(pollfd{ listen_fd, POLLIN, 0 });
+            for (const Client& client : clients) fds.push_back(pollfd{ client.fd, POLLIN, 0 });
+
+            int timeout = -1;
+            if (updates_pending) {
+                Clock::duration wait = last_flush + frame_interval() - Clock::now();
+                timeout = wait <= Clock::duration::zero() ? 0
+                    : static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wait).count()) + 1;
+            }
+            if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) break;
+            if (fds[0].revents) break; // shutting down
+
+            if (fds[1].revents) accept_clients();
+
+            // fds[2..] match clients as they were before accepting; walk backwards to erase
+            for (size_t i = fds.size(); i-- > 2;) {
+                if (!fds[i].revents) continue;
+                Client& client = clients[i - 2];
+                bool open = true;
+                ssize_t n;
+                while ((n = read(client.fd, buffer, sizeof(buffer))) > 0) {
+                    client.reader.feed(buffer, static_cast<size_t>(n),
+                        [this, &client](const std::string& line) { handle_line(client.fd, line); });
+                    if (client.reader.buffered() > MAX_LINE) {
+                        reply(client.fd, "error: line too long");
+                        open = false;
+                        break;
+                    }
+                }
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) open = false;
+                if (!open) {
+                    ::close(client.fd);
+                    clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(i - 2));
+                }
+            }
+
+            if (updates_pending && Clock::now() >= last_flush + frame_interval()) {
+                flush_updates();
+                last_flush = Clock::now();
+            }
+        }
+    }
+
+    void accept_clients() {
+        int fd;
+        while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0) {
+            if (static_cast<int>(clients.size()) >= MAX_CLIENTS) {
+                reply(fd, "error: too many clients");
+                ::close(fd);
+                continue;
+            }
+            set_nonblocking(fd);
+            clients.push_back(Client{ fd, LineReader() });
+        }
+    }
+
+    void handle_line(int fd, const std::string& line) {
+        std::string name = line.substr(0, line.find_first_of(" \t"));
+        const CommandSpec* spec = find_command(name);
+        if (!spec) {
+            reply(fd, "error: unknown command " + name);
+            return;
+        }
+        CommandArgs args;
+        if (!parse_command_args(*spec, line, args)) {
+            reply(fd, "error: invalid marquee id");
+            return;
+        }
+
+        bool is_text = name == "set_text";
+        if (!is_text && name != "set_speed") {
+            queue_command(line, FROM_CONTROL);
+            reply(fd, "ok");
+            return;
+        }
+        // a socket client cannot answer a prompt, so the value must be on the line
+        int speed = is_text ? 0 : parse_positive(args.value);
+        if (is_text ? args.value.empty() : speed == 0) {
+            reply(fd, is_text ? "error: set_text needs the text on the same line" : "error: set_speed needs a speed in ms");
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(control_updates_mutex);
+            if (is_text) control_updates.text[args.lane] = args.value;
+            else control_updates.speed[args.lane] = speed;
+        }
+        updates_pending = true;
+        reply(fd, "ok");
+    }
+
+    // hands the coalesced updates to the command thread unless a batch is still waiting there
+    void flush_updates() {
+        updates_pending = false;
+        {
+            std::lock_guard<std::mutex> lock(control_updates_mutex);
+            if (control_updates_queued) return; // the waiting batch picks these up too
+            control_updates_queued = true;
+        }
+        queue_command(std::string(), CONTROL_UPDATES);
+    }
+
+    int listen_fd = -1;
+    int wake_pipe[2] = { -1, -1 };
+    std::string path;
+    std::thread thread;
+    std::vector<Client> clients;
+    bool updates_pending = false;
+};
+
+ControlServer control_server;
+#endif
+
+// --- Helper: redraw prompt and position cursor ---
+void redraw_prompt_and_place_cursor() {
+    std::lock_guard<std::mutex> prompt_lock(prompt_mutex);
+    CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+    std::lock_guard<std::mutex> screen_lock(screen_mutex);
+    draw_prompt();
+
+    FrameBuffer& frame = ui_frame;
+    present_grid(frame);
+    int input_col = layout.prompt_col + static_cast<int>(prompt_display.size());
+    frame.move_to(input_col, layout.prompt_row + 2);
+    flush_frame(frame);
+}
+
+#ifdef MARQUEE_ALLOC_PROBE
+// --- Allocation probe (--alloc-probe) ---
+// Part of: Marquee Animation Logic
+// Renders marquee frames into a discarded buffer and counts the heap
+// allocations made per steady-state frame. Anything above zero is a regression.
+// Frames go through present_grid with a recording running (to the null
+// device), so the recorder's encoding, keyframes and dictionary resets count too.
+int run_alloc_probe() {
+    const int probe_lanes = 6;
+    const int warmup_frames = 1000;
+    const int probe_frames = 100000;
+
+    // tall enough for every lane's rows
+    const int probe_height = 18 + help_entry_count + probe_lanes - 1 + BANNER_ROWS;
+    for (int id = 1; id <= probe_lanes; ++id) ensure_marquee_lane(id);
+    apply_layout(120, probe_height);
+    const std::string fields_text = "{time} load {file:/proc/loadavg}";
+    file_fields().prefetch(fields_text); // as set_text does, before the locks
+    {
+        // every color style is drawn by some lane, the last lane is a banner
+        // and the first one has dynamic fields
+        CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+        std::lock_guard<std::mutex> state_lock(marquee_state_mutex);
+        std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+        for (MarqueeConfig& lane : lanes->lanes) {
+            lane.speed = 10 * lane.id;
+            lane.running = true;
+            lane.style = static_cast<MarqueeStyle>(lane.id % (STYLE_KEYWORDS + 1));
+            lane.keywords.assign(1, "marquee");
+            lane.font = lane.id == probe_lanes ? FONT_BANNER : FONT_NORMAL;
+            std::string text = lane.id == 1 ? fields_text + lane.content->text : lane.content->text;
+            lane.content = make_marquee_text(text, layout.marquee_width, lane.content->version, lane.style, lane.keywords, lane.font);
+        }
+        assign_slots(*lanes);
+        marquee_set.publish(std::move(lanes));
+    }
+    apply_layout(120, probe_height);
+    {
+        CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+        std::lock_guard<std::mutex> screen_lock(screen_mutex);
+        screen.resize(layout.screen_width, layout.screen_height);
+    }
+
+    // a private renderer on a synthetic clock that advances 10ms per frame,
+    // so lanes of different speeds interleave
+    MarqueeRenderer renderer;
+    MarqueeScheduler::Clock::time_point now = MarqueeScheduler::Clock::now();
+    renderer.sync(now);
+    FrameBuffer frame;
+#ifdef _WIN32
+    const char* discard_path = "NUL";
+#else
+    const char* discard_path = "/dev/null";
+#endif
+    {
+        std::lock_guard<std::mutex> screen_lock(screen_mutex);
+        recorder.use_clock(&now);
+        if (!recorder.start(discard_path, screen)) {
+            fprintf(stderr, "alloc-probe: cannot record to %s\n", discard_path);
+            return 1;
+        }
+    }
+    auto render_frame = [&renderer, &frame, &now]() {
+        renderer.sync(now);
+        std::lock_guard<std::mutex> screen_lock(screen_mutex);
+        SnapshotCell<ConsoleLayout>::Read view = layout_view.read();
+        renderer.advance_due(now, *view);
+        present_grid(frame);
+        frame.clear();
+        now += std::chrono::milliseconds(10);
+    };
+
+    // first frames grow the frame buffer and the deadline heap to their working size
+    for (int i = 0; i < warmup_frames; ++i) render_frame();
+
+    unsigned long long before = heap_allocations.load();
+    for (int i = 0; i < probe_frames; ++i) render_frame();
+    unsigned long long allocations = heap_allocations.load() - before;
+    {
+        std::lock_guard<std::mutex> screen_lock(screen_mutex);
+        recorder.stop();
+        recorder.use_clock(nullptr);
+    }
+
+    printf("alloc-probe: %d frames, %d lanes, %llu heap allocations (%.4f per frame)\n",
+        probe_frames, probe_lanes, allocations, static_cast<double>(allocations) / probe_frames);
+    return allocations == 0 ? 0 : 1;
+}
+#endif
+
+// --- Frame benchmark (--bench [null|memory] [style] [font]) ---
+// Part of: Marquee Animation Logic
+// Renders marquee frames headlessly into an output sink for a sweep of marquee
+// widths and text lengths, and reports what each frame costs. The clock is
+// synthetic (each frame jumps to the next lane deadline); frame times are real.
+std::string bench_text(int length) {
+    const char* pattern = "CSOPESY marquee benchmark ";
+    std::string text;
+    while (static_cast<int>(text.size()) < length) text.append(pattern);
+    text.resize(static_cast<size_t>(length));
+    return text;
+}
+
+int run_bench(const char* sink_name, const char* style_name, const char* font_name) {
+    typedef MarqueeScheduler::Clock Clock;
+    const int bench_lanes = 4;
+    const int warmup_frames = 500;
+    const int bench_frames = 20000;
+    const int widths[] = { 41, 80, 160, 320 };
+    const int text_lengths[] = { 16, 128, 1024, 8192 };
+
+    NullSink null_sink;
+    MemorySink memory_sink;
+    bool to_memory = sink_name && strcmp(sink_name, "memory") == 0;
+    OutputSink* sink = to_memory ? static_cast<OutputSink*>(&memory_sink) : &null_sink;
+    output_sink = sink;
+
+    int style = 0;
+    while (style < STYLE_KEYWORDS && strcmp(style_name, style_names[style]) != 0) ++style;
+    std::vector<std::string> keywords(1, "marquee");
+    int font = strcmp(font_name, font_names[FONT_BANNER]) == 0 ? FONT_BANNER : FONT_NORMAL;
+    int rows = font == FONT_BANNER ? BANNER_ROWS : 1;
+
+    for (int id = 1; id <= bench_lanes; ++id) ensure_marquee_lane(id);
+    for (int id = 1; id <= bench_lanes; ++id) set_marquee_font(id, static_cast<MarqueeFont>(font));
+    std::vector<long long> frame_ns(static_cast<size_t>(bench_frames));
+    FrameBuffer frame;
+
+    printf("sink=%s style=%s font=%s lanes=%d frames=%d\n", to_memory ? "memory" : "null", style_names[style], font_names[font],
+        bench_lanes, bench_frames);
+    printf("%6s %6s %12s %12s %15s %10s %10s\n", "width", "text", "fps", "bytes/frame", "syscalls/frame", "p50(us)", "p99(us)");
+    for (int width : widths) {
+        // tall enough for every lane's rows
+        apply_layout(width + 20, (std::max)(40, 18 + help_entry_count + bench_lanes * rows));
+        for (int length : text_lengths) {
+            {
+                CountedLock layout_lock(layout_mutex, &ThreadCounters::layout_wait);
+                std::lock_guard<std::mutex> state_lock(marquee_state_mutex);
+                std::unique_ptr<MarqueeSet> lanes = edit_marquee_set();
+                std::string text = bench_text(length);
+                for (MarqueeConfig& lane : lanes->lanes) {
+                    lane.style = static_cast<MarqueeStyle>(style);
+                    lane.keywords = keywords;
+                    lane.content = make_marquee_text(text, layout.marquee_width, lane.content->version + 1, lane.style, keywords, lane.font);
+                    lane.speed = 10 * lane.id;
+                    lane.running = true;
+                }
+                lanes->fps_cap = MAX_FPS_CAP;
+                marquee_set.publish(std::move(lanes));
+            }
+            SnapshotCell<ConsoleLayout>::Read view = layout_view.read();
+            screen.resize(view->screen_width, view->screen_height);
+
+            MarqueeRenderer renderer;
+            Clock::time_point now = Clock::now();
+            renderer.sync(now);
+            auto render_frame = [&]() {
+                now = renderer.next_deadline();
+                Clock::time_point start = Clock::now();
+                renderer.advance_due(now, *view);
+                screen.present(frame);
+                flush_frame(frame);
+                Clock::time_point end = Clock::now();
+                memory_sink.captured.clear();
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            };
+
+            for (int i = 0; i < warmup_frames; ++i) render_frame();
+            sink->bytes_written = 0;
+            sink->syscalls = 0;
+            long long total_ns = 0;
+            for (int i = 0; i < bench_frames; ++i) {
+                frame_ns[i] = render_frame();
+                total_ns += frame_ns[i];
+            }
+
+            std::sort(frame_ns.begin(), frame_ns.end());
+            double fps = total_ns > 0 ? bench_frames * 1e9 / total_ns : 0.0;
+            printf("%6d %6d %12.0f %12.1f %15.3f %10.2f %10.2f\n", width, length, fps,
+                static_cast<double>(sink->bytes_written) / bench_frames,
+                static_cast<double>(sink->syscalls) / bench_frames,
+                frame_ns[bench_frames / 2] / 1e3, frame_ns[bench_frames * 99 / 100] / 1e3);
+        }
+    }
+    output_sink = &console_sink;
+    return 0;
+}
+
+// --- Command interpreter ---
+// Part of: Command Recognition & Command Interpreter
+enum CommandState { NORMAL, WAITING_TEXT, WAITING_SPEED };
+CommandState command_state = NORMAL;
+int pending_lane = DEFAULT_LANE;   // lane the WAITING states apply to
+
+void set_prompt(const char* text) {
+    std::lock_guard<std::mutex> lock(prompt_mutex);
+    prompt_display = text;
+}
+
+// --- Command handlers ---
+// Each runs one parsed command and returns false to end the session.
+bool run_help(const CommandArgs&) {
+    help_visible = true;
+    show_help_line();
+    return true;
+}
+
+bool run_start_marquee(const CommandArgs& args) {
+    set_marquee_running(args.lane, true);
+    help_visible = false;
+    show_help_tip();
+    update_status_line();
+    return true;
+}
+
+bool run_stop_marquee(const CommandArgs& args) {
+    set_marquee_running(args.lane, false);
+    help_visible = false;
+    show_help_tip();
+    update_status_line();
+    return true;
+}
+
+bool run_set_text(const CommandArgs& args) {
+    help_visible = false;
+    if (args.value.empty()) {
+        // no text on the line: ask for it at the prompt
+        command_state = WAITING_TEXT;
+        pending_lane = args.lane;
+        set_prompt("Enter text for marquee: ");
+    }
+    else {
+        set_marquee_text(args.lane, args.value);
+    }
+    show_help_tip();
+    update_status_line();
+    return true;
+}
+
+bool run_set_source(const CommandArgs& args) {
+    // set_source [id] [-f] <path>: the path is the rest of the line and may contain spaces
+    std::string path = args.value;
+    bool follow = path == "-f" || path.compare(0, 3, "-f ") == 0 || path.compare(0, 3, "-f\t") == 0;
+    if (follow) {
+        path.erase(0, 2);
+        trim_command(path);
+    }
+    help_visible = false;
+    if (path.empty())
+        show_error_line("Usage: ", "set_source [id] [-f] <path>");
+    else if (!set_marquee_source(args.lane, path, follow))
+        show_error_line("Cannot open source: ", path);
+    else
+        show_help_tip();
+    update_status_line();
+    return true;
+}
+
+bool run_set_speed(const CommandArgs& args) {
+    help_visible = false;
+    if (args.value.empty()) {
+        // no speed on the line: ask for it at the prompt
+        command_state = WAITING_SPEED;
+        pending_lane = args.lane;
+        set_prompt("Enter speed in ms: ");
+    }
+    else {
+        int speed = parse_positive(args.value);
+        if (speed > 0) set_marquee_speed(args.lane, speed);
+        else show_error_line("Invalid speed: ", args.value);
+    }
+    show_help_tip();
+    update_status_line();
+    return true;
+}
+
+bool run_set_style(const CommandArgs& args) {
+    // set_style [id] <style> [word...]: keyword words follow the style name
+    std::istringstream words(args.value);
+    std::string name;
+    words >> name;
+    int style = 0;
+    while (style <= STYLE_KEYWORDS && name != style_names[style]) ++style;
+    std::vector<std::string> keywords;
+    for (std::string word; words >> word;) keywords.push_back(word);
+    help_visible = false;
+    if (style > STYLE_KEYWORDS)
+        show_error_line("Usage: ", "set_style [id] plain|rainbow|gradient|keywords <word>...");
+    else if (style == STYLE_KEYWORDS && keywords.empty())
+        show_error_line("No keywords given: ", "set_style [id] keywords <word>...");
+    else {
+        set_marquee_style(args.lane, static_cast<MarqueeStyle>(style), keywords);
+        show_help_tip();
+    }
+    return true;
+}
+
+bool run_set_font(const CommandArgs& args) {
+    int font = 0;
+    while (font <= FONT_BANNER && args.value != font_names[font]) ++font;
+    help_visible = false;
+    if (font > FONT_BANNER) {
+        show_error_line("Usage: ", "set_font [id] normal|banner");
+    }
+    else {
+        set_marquee_font(args.lane, static_cast<MarqueeFont>(font));
+        show_help_tip();
+    }
+    return true;
+}
+
+bool run_set_fps(const CommandArgs& args) {
+    help_visible = false;
+    int fps = parse_positive(args.value);
+    if (fps > 0) set_render_fps(fps);
+    else show_error_line("Invalid frame rate: ", args.value);
+    show_help_tip();
+    return true;
+}
+
+bool run_timing(const CommandArgs&) {
+    help_visible = false;
+    show_timing();
+    return true;
+}
+
+bool run_jitter(const CommandArgs& args) {
+    // jitter reset starts a new measurement (e.g. after changing what else runs on the host)
+    help_visible = false;
+    if (args.value == "reset") {
+        for (ThreadCounters& counters : thread_counters) counters.jitter.reset();
+    }
+    else if (!args.value.empty()) {
+        show_error_line("Unknown jitter option: ", args.value);
+        return true;
+    }
+    show_jitter();
+    return true;
+}
+
+bool run_stats(const CommandArgs& args) {
+    // optional file name: stats <file> also writes the counters as JSON
+    help_visible = false;
+    show_stats(args.value);
+    return true;
+}
+
+bool run_record(const CommandArgs& args) {
+    // record <file> starts (or restarts) a recording, record stop ends it
+    help_visible = false;
+    std::string message;
+    bool ok = true;
+    {
+        std::lock_guard<std::mutex> screen_lock(screen_mutex);
+        if (args.value.empty()) {
+            message = recorder.active() ? recorder.path() : "";
+        }
+        else if (args.value == "stop") {
+            message = recorder.active() ? recorder.path() : "";
+            recorder.stop();
+        }
+        else {
+            ok = recorder.start(args.value, screen);
+            message = args.value;
+        }
+    }
+    if (!ok)
+        show_error_line("Cannot write recording: ", message);
+    else if (args.value == "stop")
+        show_info_line(message.empty() ? "Not recording" : "Recording saved: ", message);
+    else
+        show_info_line(message.empty() ? "Not recording" : "Recording to: ", message);
+    return true;
+}
+
+bool run_exit(const CommandArgs&) {
+    is_running = false;
+    return false;
+}
+
+// --- Command registry ---
+// Part of: Command Recognition & Command Interpreter
+// Arguments follow the command on the same line: "<command> [lane id] [value]".
+// A lane id may be written "#2"; set_text reads a bare leading number as a lane
+// only when that lane exists and text follows (see parse_command_args).
+const CommandSpec command_table[] = {
+    { "help", 0, run_help },
+    { "start_marquee", TAKES_LANE, run_start_marquee },
+    { "stop_marquee", TAKES_LANE, run_stop_marquee },
+    { "set_text", TAKES_LANE | TAKES_VALUE | TEXT_VALUE, run_set_text },
+    { "set_source", TAKES_LANE | TAKES_VALUE, run_set_source },
+    { "set_speed", TAKES_LANE | TAKES_VALUE | NUMERIC_VALUE, run_set_speed },
+    { "set_style", TAKES_LANE | TAKES_VALUE, run_set_style },
+    { "set_font", TAKES_LANE | TAKES_VALUE, run_set_font },
+    { "set_fps", TAKES_VALUE, run_set_fps },
+    { "timing", 0, run_timing },
+    { "jitter", TAKES_VALUE, run_jitter },
+    { "stats", TAKES_VALUE, run_stats },
+    { "record", TAKES_VALUE, run_record },
+    { "exit", 0, run_exit },
+};
+
+const CommandSpec* find_command(const std::string& name) {
+    for (const CommandSpec& spec : command_table) {
+        if (name == spec.name) return &spec;
+    }
+    return nullptr;
+}
+
+// runs one input line; returns false when it was `exit`
+// (only keyboard input can answer a set_text/set_speed prompt)
+bool execute_command(const std::string& line, bool from_keyboard = true) {
+    // handle WAITING states: these are inputs for multi-step commands
+    if (from_keyboard && command_state != NORMAL) {
+        if (command_state == WAITING_TEXT) {
+            set_marquee_text(pending_lane, line);
+        }
+        else {
+            int speed = parse_positive(line);
+            if (speed > 0) set_marquee_speed(pending_lane, speed);
+        }
+        command_state = NORMAL;
+        set_prompt(">> ");
+        update_status_line();
+        return true;
+    }
+
+    std::string name = line.substr(0, line.find_first_of(" \t"));
+    const CommandSpec* spec = find_command(name);
+    if (!spec) {
+        //unknown command
+        show_error_line("Unknown command: ", line);
+        return true;
+    }
+    CommandArgs args;
+    if (!parse_command_args(*spec, line, args)) {
+        show_error_line("Invalid marquee id: ", args.lane_word);
+        return true;
+    }
+    // naming a new lane adds a row to the marquee box
+    if ((spec->flags & TAKES_LANE) && ensure_marquee_lane(args.lane)) layout_redraw_pending = true;
+    return spec->run(args);
+}
+
+// --- Command batches ---
+// Part of: Command Recognition & Command Interpreter
+// Commands that were queued together run back to back and only draw into the
+// back grid; finish() then repaints once (the whole UI if a lane was added)
+// and puts the cursor back at the prompt. A pasted script of 1,000 commands
+// costs one repaint, not 1,000.
+class CommandBatch {
+public:
+    // returns false when the command was `exit`
+    bool run(const QueuedCommand& command) {
+        queued.push_back(command.queued);
+        if (command.origin == CONTROL_UPDATES) {
+            apply_control_updates();
+            return true;
+        }
+        return execute_command(command.line, command.origin == FROM_KEYBOARD);
+    }
+
+    void finish() {
+        if (queued.empty()) return;
+        if (layout_redraw_pending) {
+            layout_redraw_pending = false;
+            display_static_ui();
+        }
+        else {
+            redraw_prompt_and_place_cursor();
+        }
+        // command latency runs until the batch is on screen
+        ThreadCounters& counters = my_counters();
+        for (std::chrono::steady_clock::time_point at : queued) counters.command_latency.record(elapsed_ns(at));
+        queued.clear();
+    }
+
+private:
+    std::vector<std::chrono::steady_clock::time_point> queued;
+};
+
+// --- Shutdown message (both run modes) ---
+void print_shutdown_message() {
+    clear_screen();
+    FrameBuffer text;
+    put_sgr(text, Attrs::RESET, Attrs::BRIGHT_RED);
+    text.put("CSOPESY Marquee System shutting down...\n");
+    put_sgr(text, Attrs::BRIGHT_RED, Attrs::BRIGHT_YELLOW);
+    text.put("Thank you for using our system!");
+    put_sgr(text, Attrs::BRIGHT_YELLOW, Attrs::RESET);
+    text.put("\n");
+    std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+#ifdef __linux__
+// --- Reactor sink: non-blocking terminal output owned by the event loop ---
+// Part of: Console UI Implementation
+// Writes what the terminal takes right away and keeps the rest until epoll
+// reports stdout writable again. When a stuck terminal lets the backlog grow
+// past the cap, it is dropped and the loop repaints the whole screen instead.
+class ReactorSink : public OutputSink {
+public:
+    static const size_t PENDING_CAP = 1 << 20;
+
+    void write(const char* data, size_t len) override {
+        bytes_written += len;
+        if (broken) return;
+        if (pending.empty()) {
+            size_t sent = send(data, len);
+            data += sent;
+            len -= sent;
+        }
+        if (len == 0 || broken) return;
+        if (pending.size() + len > PENDING_CAP) {
+            pending.clear();
+            needs_repaint = true;
+            return;
+        }
+        pending.append(data, len);
+    }
+
+    // called when stdout is writable
+    void flush() {
+        size_t sent = send(pending.data(), pending.size());
+        pending.erase(0, sent);
+    }
+
+    // finish output on the way out (stdout is blocking again by then)
+    void drain() {
+        if (!pending.empty()) syscalls += write_all(STDOUT_FILENO, pending.data(), pending.size());
+        pending.clear();
+    }
+
+    bool busy() const { return !pending.empty(); }
+
+    bool needs_repaint = false;
+    bool broken = false;   // stdout failed for good (EIO, EPIPE): output is dropped from then on
+
+private:
+    size_t send(const char* data, size_t len) {
+        size_t sent = 0;
+        while (sent < len) {
+            ssize_t n = ::write(STDOUT_FILENO, data + sent, len - sent);
+            ++syscalls;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    // output is gone: drop the backlog so nothing waits on it, keep running
+                    broken = true;
+                    pending.clear();
+                    return len;
+                }
+                break; // wait for EPOLLOUT
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return sent;
+    }
+
+    std::string pending;
+};
+
+// --- Event-loop mode: one thread multiplexes input, timers, signals and output ---
+// Part of: Command Recognition & Marquee Animation Logic
+// epoll waits on stdin, a tick timerfd armed at the next lane deadline, a
+// settle timerfd for resize bursts, a signalfd (SIGWINCH/SIGINT/SIGTERM) and,
+// while output is backed up, stdout. Commands from the control socket arrive
+// through command_queue and an eventfd. Everything runs on this thread, so the
+// frame path takes no locks, and exit or a signal ends the loop at once.
+// stdin/stdout that epoll cannot watch (regular files) are treated as always ready.
+void arm_timer(int fd, std::chrono::steady_clock::time_point at) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(at.time_since_epoch()).count();
+    if (ns <= 0) ns = 1; // an all-zero value would disarm the timer
+    spec.it_value.tv_sec = static_cast<time_t>(ns / 1000000000LL);
+    spec.it_value.tv_nsec = static_cast<long>(ns % 1000000000LL);
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void disarm_timer(int fd) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    timerfd_settime(fd, 0, &spec, nullptr);
+}
+
+int run_reactor() {
+    typedef MarqueeScheduler::Clock Clock;
+    enum Source { INPUT, TICK, SETTLE, SIGNALS, OUTPUT, COMMANDS };
+
+    sigset_t handled, previous_mask;
+    sigemptyset(&handled);
+    sigaddset(&handled, SIGWINCH);
+    sigaddset(&handled, SIGINT);
+    sigaddset(&handled, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &handled, &previous_mask);
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int tick_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int settle_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int signal_fd = signalfd(-1, &handled, SFD_NONBLOCK | SFD_CLOEXEC);
+    int queue_fd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC); // starts signalled: commands may already be queued
+    if (epoll_fd < 0 || tick_fd < 0 || settle_fd < 0 || signal_fd < 0 || queue_fd < 0) {
+        fprintf(stderr, "reactor: cannot create event descriptors: %s\n", strerror(errno));
+        pthread_sigmask(SIG_SETMASK, &previous_mask, nullptr);
+        return 1;
+    }
+
+    auto watch = [epoll_fd](int fd, Source source, unsigned int events) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.u32 = source;
+        return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    };
+    watch(tick_fd, TICK, EPOLLIN);
+    watch(settle_fd, SETTLE, EPOLLIN);
+    watch(signal_fd, SIGNALS, EPOLLIN);
+    watch(queue_fd, COMMANDS, EPOLLIN);
+    command_event_fd = queue_fd;
+
+    int stdin_flags = fcntl(STDIN_FILENO, F_GETFL);
+    int stdout_flags = fcntl(STDOUT_FILENO, F_GETFL);
+    fcntl(STDIN_FILENO, F_SETFL, stdin_flags | O_NONBLOCK);
+    fcntl(STDOUT_FILENO, F_SETFL, stdout_flags | O_NONBLOCK);
+    bool input_polled = watch(STDIN_FILENO, INPUT, EPOLLIN);
+    bool output_polled = watch(STDOUT_FILENO, OUTPUT, 0); // EPOLLOUT only while output is pending
+    bool output_armed = false;
+    if (!output_polled) fcntl(STDOUT_FILENO, F_SETFL, stdout_flags); // plain file: blocking writes never stall
+
+    ReactorSink sink;
+    output_sink = &sink;
+    display_static_ui();
+
+    MarqueeRenderer& renderer = marquee_renderer;
+    LineReader reader;
+    bool input_open = true;
+    bool running = true;
+    bool resize_pending = false;         // a resize burst is being coalesced
+    Clock::time_point resize_follow_at;  // its settle timer fires no later than this
+    CommandBatch commands;   // everything one loop iteration received is repainted once
+    auto run_line = [&running, &commands](const std::string& line) {
+        if (!running) return; // input after exit is ignored
+        if (!commands.run(QueuedCommand{ line, Clock::now(), FROM_KEYBOARD })) running = false;
+    };
+
+    while (running) {
+        renderer.sync(Clock::now());
+        // while output is backed up the tick waits too: its deadline is soon in
+        // the past and would fire on every pass. Once stdout drains, the next
+        // pass re-arms it and the frame jumps to the current position.
+        if (renderer.idle() || sink.busy()) disarm_timer(tick_fd);
+        else arm_timer(tick_fd, renderer.next_deadline());
+
+        if (sink.broken && output_polled) {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, STDOUT_FILENO, nullptr);
+            output_polled = false;
+        }
+        if (sink.busy() != output_armed && output_polled) {
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = sink.busy() ? static_cast<unsigned int>(EPOLLOUT) : 0u;
+            ev.data.u32 = OUTPUT;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, STDOUT_FILENO, &ev);
+            output_armed = sink.busy();
+        }
+
+        // stdin that epoll cannot watch is a file: read it without waiting
+        int timeout = (input_open && !input_polled) ? 0 : -1;
+        struct epoll_event events[9]; // one spare for unwatched stdin
+        int ready = epoll_wait(epoll_fd, events, 8, timeout);
+        if (ready < 0 && errno != EINTR) break;
+
+        if (input_open && !input_polled) {
+            events[ready > 0 ? ready : 0].data.u32 = INPUT;
+            ready = (ready > 0 ? ready : 0) + 1;
+        }
+
+        for (int i = 0; i < ready && running; ++i) {
+            switch (events[i].data.u32) {
+            case INPUT: {
+                char buffer[4096];
+                ssize_t n;
+                while (running && (n = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0)
+                    reader.feed(buffer, static_cast<size_t>(n), run_line);
+                if (running && (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))) {
+                    // end of input ends the session, like the threaded mode
+                    reader.finish(run_line);
+                    input_open = false;
+                    running = false;
+                }
+                break;
+            }
+            case TICK: {
+                uint64_t expirations;
+                ssize_t ignored = read(tick_fd, &expirations, sizeof(expirations));
+                (void)ignored;
+                if (sink.busy()) break; // the terminal is behind: later frames carry this one's changes
+                SnapshotCell<ConsoleLayout>::Read view = layout_view.read();
+                Clock::time_point deadline = renderer.next_deadline();
+                Clock::time_point start = Clock::now();
+                if (!renderer.advance_due(start, *view)) break;
+                FrameBuffer& frame = ui_frame;
+                frame.save_cursor();
+                if (present_grid(frame)) {
+                    frame.restore_cursor();
+                    size_t bytes = frame.size();
+                    sink.write(frame.data(), bytes);
+                    ThreadCounters& counters = my_counters();
+                    counters.jitter.record(std::chrono::duration_cast<std::chrono::nanoseconds>(start - deadline).count());
+                    counters.frame_time.record(elapsed_ns(start));
+                    counters.frame_bytes.fetch_add(bytes, std::memory_order_relaxed);
+                }
+                frame.clear();
+                break;
+            }
+            case SETTLE: {
+                uint64_t expirations;
+                ssize_t ignored = read(settle_fd, &expirations, sizeof(expirations));
+                (void)ignored;
+                resize_pending = false;
+                check_and_handle_resize();
+                break;
+            }
+            case SIGNALS: {
+                struct signalfd_siginfo info;
+                while (read(signal_fd, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info))) {
+                    if (info.ssi_signo == SIGWINCH) {
+                        // restart the settle delay on every signal of a resize burst,
+                        // but handle a long burst at least every RESIZE_FOLLOW_MS
+                        Clock::time_point now = Clock::now();
+                        if (!resize_pending) {
+                            resize_pending = true;
+                            resize_follow_at = now + std::chrono::milliseconds(RESIZE_FOLLOW_MS);
+                        }
+                        arm_timer(settle_fd, (std::min)(now + std::chrono::milliseconds(RESIZE_SETTLE_MS), resize_follow_at));
+                    }
+                    else {
+                        running = false;
+                    }
+                }
+                break;
+            }
+            case OUTPUT:
+                sink.flush();
+                break;
+            case COMMANDS: {
+                // commands from the control socket, queued by its thread
+                uint64_t count;
+                ssize_t ignored = read(queue_fd, &count, sizeof(count));
+                (void)ignored;
+                while (running) {
+                    QueuedCommand command;
+                    {
+                        std::lock_guard<std::mutex> lock(command_queue_mutex);
+                        if (command_queue.empty()) break;
+                        command = command_queue.front();
+                        command_queue.pop();
+                    }
+                    if (!commands.run(command)) running = false;
+                }
+                break;
+            }
+            }
+        }
+        if (running) commands.finish();
+
+        if (sink.needs_repaint && !sink.busy()) {
+            sink.needs_repaint = false;
+            display_static_ui();
+        }
+    }
+
+    is_running = false;
+    control_server.stop();
+    command_event_fd = -1;
+    fcntl(STDIN_FILENO, F_SETFL, stdin_flags);
+    fcntl(STDOUT_FILENO, F_SETFL, stdout_flags);
+    sink.drain();
+    output_sink = &console_sink;
+    recorder.stop();
+    close(queue_fd);
+    close(signal_fd);
+    close(settle_fd);
+    close(tick_fd);
+    close(epoll_fd);
+    pthread_sigmask(SIG_SETMASK, &previous_mask, nullptr);
+    print_shutdown_message();
+    return 0;
+}
+#endif
+
+// --- Scripted replay (--replay <script> <frames file>) ---
+// Part of: Command Recognition & Marquee Animation Logic
+// Runs a timestamped command script against a virtual clock instead of the
+// keyboard and the real one. Script lines are "t=<ms> <command>" in time
+// order; blank lines and lines starting with # are skipped, and
+// "t=<ms> resize <width> <height>" simulates a terminal resize. Between two
+// commands the clock jumps from one lane deadline to the next, so the frames
+// written to the file are the same on every run and thousands of simulated
+// seconds take a fraction of a second. The run ends at `exit` or after the
+// last script line. Streamed sources (set_source) depend on their feeder
+// thread, so scripts that use them are not reproducible.
+struct ScriptCommand {
+    long long at_ms;
+    std::string line;
+    int source_line;
+};
+
+bool load_script(const char* path, std::vector<ScriptCommand>& script) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "replay: cannot open script %s\n", path);
+        return false;
+    }
+    bool ok = true;
+    int number = 0;
+    long long last_ms = 0;
+    char buffer[4096];
+    while (ok && fgets(buffer, sizeof(buffer), file)) {
+        ++number;
+        std::string line = buffer;
+        trim_command(line);
+        if (line.empty() || line[0] == '#') continue;
+
+        char* end = nullptr;
+        long long at_ms = line.compare(0, 2, "t=") == 0 ? strtoll(line.c_str() + 2, &end, 10) : -1;
+        if (at_ms < 0 || !end || end == line.c_str() + 2 || (*end != ' ' && *end != '\t')) {
+            fprintf(stderr, "replay: %s:%d: expected \"t=<ms> <command>\"\n", path, number);
+            ok = false;
+        }
+        else if (at_ms < last_ms) {
+            fprintf(stderr, "replay: %s:%d: time goes backwards (t=%lld after t=%lld)\n", path, number, at_ms, last_ms);
+            ok = false;
+        }
         else {
-            //unknown command
-            save_cursor();
-            std::lock_guard<std::mutex> layout_lock(layout_mutex);
-            clear_line(layout.help_row + 7, layout.screen_width);
-            gotoxy(1, layout.help_row + 7);
-            std::cout << Colors::RED << "Unknown command: " << line << Colors::RESET << std::flush;
-            restore_cursor();
+            std::string command = end;
+            trim_command(command);
+            script.push_back(ScriptCommand{ at_ms, command, number });
+            last_ms = at_ms;
+        }
+    }
+    fclose(file);
+    return ok;
+}
+
+int run_replay(const char* script_path, const char* frames_path) {
+    typedef MarqueeScheduler::Clock Clock;
+    std::vector<ScriptCommand> script;
+    if (!load_script(script_path, script)) return 1;
+
+    FileSink file_sink(frames_path);
+    if (!file_sink.is_open()) {
+        fprintf(stderr, "replay: cannot write %s\n", frames_path);
+        return 1;
+    }
+    output_sink = &file_sink;
+    fixed_console_width = 120;
+    fixed_console_height = 30;
+
+    // the virtual clock starts at an arbitrary fixed point so every run sees the same times
+    const Clock::time_point origin = Clock::time_point(std::chrono::hours(1));
+    Clock::time_point now = origin;
+    MarqueeRenderer& renderer = marquee_renderer;
+    unsigned long long frames = 0;
+    unsigned long long frame_bytes = 0;
+    Clock::time_point wall_start = Clock::now();
+
+    // a recording made by the script is timed by the virtual clock too
+    recorder.use_clock(&now);
+
+    display_static_ui();
+    renderer.sync(now);
+
+    // draws every lane deadline up to (and including) the given time
+    auto run_until = [&](Clock::time_point until) {
+        while (!renderer.idle() && renderer.next_deadline() <= until) {
+            now = (std::max)(now, renderer.next_deadline());
+            std::lock_guard<std::mutex> screen_lock(screen_mutex);
+            SnapshotCell<ConsoleLayout>::Read view = layout_view.read();
+            if (renderer.advance_due(now, *view)) {
+                frame_bytes += present_screen();
+                ++frames;
+            }
+        }
+        now = until;
+    };
+
+    size_t executed = 0;
+    CommandBatch commands;   // commands with the same timestamp are repainted together
+    for (const ScriptCommand& command : script) {
+        Clock::time_point at = origin + std::chrono::milliseconds(command.at_ms);
+        if (at > now) commands.finish();
+        run_until(at);
+        ++executed;
+        std::istringstream args(command.line);
+        std::string name;
+        int width = 0, height = 0;
+        if ((args >> name) && name == "resize") {
+            if (!(args >> width >> height) || width < 1 || height < 1) {
+                fprintf(stderr, "replay: %s:%d: expected \"resize <width> <height>\"\n", script_path, command.source_line);
+                continue;
+            }
+            commands.finish();
+            fixed_console_width = width;
+            fixed_console_height = height;
+            check_and_handle_resize();
+        }
+        else if (!commands.run(QueuedCommand{ command.line, Clock::now(), FROM_KEYBOARD })) {
+            break; // exit: the file ends with the last screen
+        }
+        renderer.sync(now);
+    }
+    if (is_running) commands.finish();
+
+    long long simulated_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - origin).count();
+    double wall_ms = elapsed_ns(wall_start) / 1e6;
+    recorder.stop();
+    recorder.use_clock(nullptr);
+    output_sink = &console_sink;
+    is_running = false;
+
+    printf("replay: %zu commands, %.3f simulated s, %llu frames, %llu bytes -> %s\n",
+        executed, simulated_ms / 1000.0, frames, frame_bytes, frames_path);
+    printf("replay: %.1f ms wall time (%.0fx real time)\n", wall_ms,
+        wall_ms > 0 ? simulated_ms / wall_ms : 0.0);
+    return 0;
+}
+
+// --- Recording player (--play <file> [speed] [from seconds]) ---
+// Part of: Display Implementation
+// Streams a recording (see FrameRecorder) back to the terminal at its
+// original pace, divided by `speed`. Starting later in the recording begins
+// at the last keyframe before that point with the frames since it applied at
+// once, then plays on in time.
+int run_play(const char* path, double speed, double from_seconds) {
+    typedef std::chrono::steady_clock Clock;
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "play: cannot read %s\n", path);
+        return 1;
+    }
+    std::string data;
+    char block[65536];
+    for (size_t n; (n = fread(block, 1, sizeof(block), file)) > 0;) data.append(block, n);
+    fclose(file);
+    if (data.compare(0, FrameRecorder::MAGIC_LEN, FrameRecorder::MAGIC) != 0) {
+        fprintf(stderr, "play: %s is not a marquee recording\n", path);
+        return 1;
+    }
+
+    size_t at = FrameRecorder::MAGIC_LEN;
+    bool truncated = false;
+    auto varint = [&data, &at, &truncated]() {
+        unsigned long long value = 0;
+        for (int shift = 0; at < data.size() && shift < 64; shift += 7) {
+            unsigned char byte = static_cast<unsigned char>(data[at++]);
+            value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        truncated = true;
+        return value;
+    };
+    std::vector<std::pair<size_t, size_t>> chunks;  // id -> offset, length in data
+    std::string pending;     // frames not yet shown (while seeking, or one record)
+    // appends a record payload to `pending`; false when the file is damaged
+    auto payload = [&]() {
+        unsigned long long count = varint();
+        for (unsigned long long c = 0; c < count && !truncated; ++c) {
+            unsigned long long tag = varint();
+            if (tag & 1) {
+                if (tag / 2 >= chunks.size()) return false;
+                const std::pair<size_t, size_t>& chunk = chunks[tag / 2];
+                pending.append(data, chunk.first, chunk.second);
+            }
+            else {
+                if (tag / 2 > data.size() - at) return false;
+                chunks.push_back(std::make_pair(at, static_cast<size_t>(tag / 2)));
+                pending.append(data, at, static_cast<size_t>(tag / 2));
+                at += static_cast<size_t>(tag / 2);
+            }
+        }
+        return !truncated;
+    };
+
+    enable_ansi_on_windows();
+    const long long from_ms = static_cast<long long>(from_seconds * 1000.0);
+    long long ms = 0;
+    int height = 0;
+    bool playing = false;
+    Clock::time_point origin;
+    varint(); // wall clock at the start of the recording
+    while (at < data.size()) {
+        char type = data[at++];
+        if (type == 'D') {
+            chunks.clear();
+            continue;
+        }
+        if (type != 'K' && type != 'F') break;
+        ms += static_cast<long long>(varint());
+        if (type == 'K') {
+            varint(); // width
+            height = static_cast<int>(varint());
+            if (!playing) pending.clear(); // seeking: everything before the keyframe is covered by it
+        }
+        if (!payload()) {
+            fprintf(stderr, "play: %s is damaged after %.3f s\n", path, ms / 1000.0);
+            break;
+        }
+        if (!playing) {
+            if (ms < from_ms) continue;
+            playing = true;
+            origin = Clock::now() - std::chrono::microseconds(static_cast<long long>((ms - from_ms) * 1000.0 / speed));
+        }
+        std::this_thread::sleep_until(origin + std::chrono::microseconds(static_cast<long long>((ms - from_ms) * 1000.0 / speed)));
+        fwrite(pending.data(), 1, pending.size(), stdout);
+        fflush(stdout);
+        pending.clear();
+    }
+    // the cursor goes below the recorded screen
+    printf("\033[0m\033[%d;1H\n", height + 1);
+    return 0;
+}
+
+// --- Main ---
+// Part of: Command Recognition & Command Interpreter
+int main(int argc, char* argv[]) {
+#ifdef MARQUEE_ALLOC_PROBE
+    if (argc > 1 && strcmp(argv[1], "--alloc-probe") == 0) return run_alloc_probe();
+#endif
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+        return run_bench(argc > 2 ? argv[2] : "null", argc > 3 ? argv[3] : "plain", argc > 4 ? argv[4] : "normal");
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "usage: %s --replay <script> <frames file>\n", argv[0]);
+            return 1;
+        }
+        ensure_marquee_lane(DEFAULT_LANE);
+        return run_replay(argv[2], argv[3]);
+    }
+    if (argc > 1 && strcmp(argv[1], "--play") == 0) {
+        double speed = argc > 3 ? atof(argv[3]) : 1.0;
+        double from = argc > 4 ? atof(argv[4]) : 0.0;
+        if (argc < 3 || speed <= 0 || from < 0) {
+            fprintf(stderr, "usage: %s --play <recording> [speed] [from seconds]\n", argv[0]);
+            return 1;
+        }
+        return run_play(argv[2], speed, from);
+    }
+
+    bool reactor_mode = false;
+    const char* control_path = nullptr;
+    const char* record_path = nullptr;
+    const char* low_jitter_cpu = nullptr;
+    std::vector<const char*> mirror_paths;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--reactor") == 0) reactor_mode = true;
+        else if (strcmp(argv[i], "--low-jitter") == 0 && i + 1 < argc) low_jitter_cpu = argv[++i];
+        else if (strcmp(argv[i], "--realtime") == 0) low_jitter.realtime = true;
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) record_path = argv[++i];
+        else if (strcmp(argv[i], "--control") == 0 && i + 1 < argc) control_path = argv[++i];
+        else if (strcmp(argv[i], "--mirror") == 0 && i + 1 < argc) mirror_paths.push_back(argv[++i]);
+    }
+
+    if (low_jitter_cpu) {
+#ifndef __linux__
+        fprintf(stderr, "--low-jitter needs Linux (CPU affinity, mlockall)\n");
+        return 1;
+#else
+        if (reactor_mode) {
+            fprintf(stderr, "--low-jitter is not supported with --reactor\n");
+            return 1;
+        }
+        char* end = nullptr;
+        long cpu = strtol(low_jitter_cpu, &end, 10);
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (end == low_jitter_cpu || *end != '\0' || cpu < 0 || cpu >= CPU_SETSIZE ||
+            sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || !CPU_ISSET(static_cast<int>(cpu), &allowed)) {
+            fprintf(stderr, "--low-jitter: CPU %s is not available to this process\n", low_jitter_cpu);
+            return 1;
+        }
+        low_jitter.enabled = true;
+        low_jitter.cpu = static_cast<int>(cpu);
+#endif
+    }
+    else if (low_jitter.realtime) {
+        fprintf(stderr, "--realtime needs --low-jitter <cpu>\n");
+        return 1;
+    }
+
+    enable_ansi_on_windows();
+
+    // lane 1 always exists; other lanes are created when a command first names them
+    ensure_marquee_lane(DEFAULT_LANE);
+
+    if (control_path) {
+#ifdef _WIN32
+        fprintf(stderr, "--control needs Unix domain sockets\n");
+        return 1;
+#else
+        if (!control_server.start(control_path)) {
+            fprintf(stderr, "Cannot open control socket %s: %s\n", control_path, strerror(errno));
+            return 1;
+        }
+#endif
+    }
+
+    if (!mirror_paths.empty()) {
+#ifdef _WIN32
+        fprintf(stderr, "--mirror needs POSIX ptys, FIFOs or files\n");
+        return 1;
+#else
+        if (reactor_mode) {
+            fprintf(stderr, "--mirror is not supported with --reactor\n");
+            return 1;
+        }
+        // a FIFO whose reader went away must not end the process (the mirror is just dropped)
+        signal(SIGPIPE, SIG_IGN);
+        int width = 0, height = 0;
+        get_console_size(width, height);
+        for (const char* path : mirror_paths) {
+            if (!writer_sink.add_mirror(path, width, height)) {
+                fprintf(stderr, "Cannot open mirror %s: %s\n", path,
+                    errno == ENXIO ? "FIFO has no reader" : strerror(errno));
+                return 1;
+            }
+        }
+#endif
+    }
+
+    if (record_path) {
+        std::lock_guard<std::mutex> screen_lock(screen_mutex);
+        if (!recorder.start(record_path, screen)) {
+            fprintf(stderr, "Cannot write recording %s: %s\n", record_path, strerror(errno));
+            return 1;
         }
+    }
+
+    if (reactor_mode) {
+#ifdef __linux__
+        return run_reactor();
+#else
+        fprintf(stderr, "--reactor needs Linux (epoll, timerfd, signalfd)\n");
+        return 1;
+#endif
+    }
 
-        // redraw prompt for next input (default prompt or state prompt)
-        redraw_prompt_and_place_cursor();
+    // resizes are signalled (SIGWINCH) where the platform supports it
+    install_resize_signal();
+    install_input_wake();
+
+    // terminal writes happen on the writer thread from here on
+    output_sink = &writer_sink;
+    writer_sink.start();
+
+    // draw UI once
+    display_static_ui();
+
+    // start marquee thread
+    std::thread marquee_thread(marquee_thread_func);
+
+    // start resize monitoring thread
+    std::thread resize_thread(resize_monitor_thread_func);
+
+    // --- Keyboard Handler ---
+    std::thread keyboard_thread(keyboard_handler_thread_func);
+
+    // commands are taken off the queue in batches: everything queued so far
+    // runs back to back and is repainted once
+    std::vector<QueuedCommand> batch;
+    CommandBatch commands;
+    while (is_running) {
+        {
+            std::unique_lock<std::mutex> lock(command_queue_mutex);
+            command_queue_cv.wait(lock, [] {
+                return !command_queue.empty() || !is_running.load();
+                });
+
+            if (!is_running) break;
+
+            ThreadCounters& counters = my_counters();
+            unsigned long long depth = command_queue.size();
+            counters.queue_depth.store(depth, std::memory_order_relaxed);
+            if (depth > counters.queue_depth_max.load(std::memory_order_relaxed))
+                counters.queue_depth_max.store(depth, std::memory_order_relaxed);
+            while (!command_queue.empty()) {
+                batch.push_back(std::move(command_queue.front()));
+                command_queue.pop();
+            }
+        }
+        bool keep_running = true;
+        for (const QueuedCommand& command : batch) {
+            keep_running = commands.run(command);
+            if (!keep_running) break;
+        }
+        batch.clear();
+        if (!keep_running) break;
+        commands.finish();
     }
 
     // shutdown
+    is_running = false;
+    wake_marquee_thread();
+    wake_resize_monitor();
+    wake_keyboard_thread();
+#ifndef _WIN32
+    control_server.stop();
+#endif
     if (marquee_thread.joinable()) marquee_thread.join();
     if (resize_thread.joinable()) resize_thread.join();
+#ifdef _WIN32
+    // a console read cannot be interrupted; the thread ends with the process
+    keyboard_thread.detach();
+#else
     if (keyboard_thread.joinable()) keyboard_thread.join();
-    clear_screen();
-    std::cout << Colors::BRIGHT_RED << "CSOPESY Marquee System shutting down..." << Colors::RESET << "\n";
-    std::cout << Colors::BRIGHT_YELLOW << "Thank you for using our system!" << Colors::RESET << "\n";
+#endif
+    {
+        std::lock_guard<std::mutex> screen_lock(screen_mutex);
+        recorder.stop();
+    }
+    writer_sink.stop();
+    output_sink = &console_sink;
+    print_shutdown_message();
     return 0;
 }